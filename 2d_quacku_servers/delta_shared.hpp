@@ -0,0 +1,363 @@
+#ifndef DELTA_SHARED_HPP_INCLUDED
+#define DELTA_SHARED_HPP_INCLUDED
+
+#include <net/shared.hpp>
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+#include <stdio.h>
+
+///host entities stream their whole state every network tick, so what goes out is only what changed
+///a state is a handful of fields (a quantised pos, an hp byte, some flags, see wire_quantiser), and a changed field
+///is always sent whole, so the bytes of a pos can never be half old and half new. Each message is
+///
+///    KEYFRAME: uint8 kind, uint8 seq, uint8 num_fields, a uint8 size per field, every field
+///    DELTA:    uint8 kind, uint8 seq, uint8 num_fields, one bit per field (was it sent), the fields that were
+///    EVENT:    uint8 kind, then whatever the sender wants. Not state, see below
+///    RESYNC:   uint8 kind
+///
+///a keyframe is every field, and the sender's baseline is whatever it last sent. Forwarded messages aren't acked,
+///so instead of deltaing against an acknowledged state we send a keyframe every keyframe_interval messages.
+///seq goes up by one every message, and a delta only applies on top of the message right before it. After a gap
+///the receiver sits on the last state it had and sends the owner a RESYNC, and the owner's next message is a
+///keyframe. That's a round trip of stale state rather than however long it is until the next keyframe
+///
+///a state that hasn't changed doesn't use up a seq, and costs nothing apart from a keyframe every
+///idle_keyframe_interval updates, which is how the server knows the entity's still there
+///
+///events and resyncs go the other way, from someone who doesn't own an entity to its owner (eg damage). They're marked so
+///nobody mistakes one for the owner's state
+///
+///the server decodes these too, to know where things are (see server_game_state::broadcast_forwarding)
+namespace delta_kind
+{
+    enum type : uint8_t
+    {
+        KEYFRAME,
+        DELTA,
+        EVENT,
+        RESYNC,
+    };
+}
+
+///a receiver that's lost track asks again every this many messages it can't use, in case the resync or the keyframe got lost too
+#define DELTA_RESYNC_INTERVAL 30
+
+///what a serialiser builds, a state plus where its fields end
+struct delta_fields
+{
+    byte_vector vec;
+    std::vector<uint8_t> sizes;
+
+    ///false once a field didn't fit. Where the fields after it start isn't known any more, so none of it can be sent
+    bool ok = true;
+
+    ///everything pushed onto vec since the last end_field is one field
+    bool end_field()
+    {
+        if(!ok)
+            return false;
+
+        uint32_t start = 0;
+
+        for(uint8_t s : sizes)
+            start += s;
+
+        uint32_t len = vec.ptr.size() - start;
+
+        if(len == 0)
+            return true;
+
+        if(len > 255)
+        {
+            printf("delta field of %i bytes is too big\n", (int)len);
+
+            ok = false;
+            return false;
+        }
+
+        sizes.push_back(len);
+
+        return true;
+    }
+};
+
+///what the receiving side has to remember besides the state itself
+struct delta_stream
+{
+    std::vector<uint8_t> sizes;
+    uint8_t last_seq = 0;
+    bool have_keyframe = false;
+
+    ///deltas thrown away since we last had a keyframe
+    uint32_t num_missed = 0;
+    ///set by delta_apply when the owner should be sent a RESYNC, the caller clears it once it has
+    bool resync_due = false;
+};
+
+inline
+void delta_push_keyframe(byte_vector& out, uint8_t seq, const std::vector<uint8_t>& sizes, const std::vector<char>& state)
+{
+    out.push_back<uint8_t>(delta_kind::KEYFRAME);
+    out.push_back<uint8_t>(seq);
+    out.push_back<uint8_t>(sizes.size());
+
+    for(uint8_t s : sizes)
+    {
+        out.push_back<uint8_t>(s);
+    }
+
+    out.ptr.insert(out.ptr.end(), state.begin(), state.end());
+}
+
+inline
+void delta_push_resync(byte_vector& out)
+{
+    out.push_back<uint8_t>(delta_kind::RESYNC);
+}
+
+inline
+void delta_count_missed(delta_stream& stream)
+{
+    stream.num_missed++;
+
+    if(stream.num_missed % DELTA_RESYNC_INTERVAL == 1)
+        stream.resync_due = true;
+}
+
+inline
+bool delta_is_event(const char* data, uint32_t len)
+{
+    return len > 0 && (uint8_t)data[0] == delta_kind::EVENT;
+}
+
+///reads one message, which has to be all of data. True if state is now the sender's state
+///events, and deltas we can't use, are thrown away without touching state
+inline
+bool delta_apply(const char* data, uint32_t len, std::vector<char>& state, delta_stream& stream)
+{
+    if(len < 3)
+        return false;
+
+    uint8_t kind = data[0];
+    uint8_t seq = data[1];
+    uint32_t num_fields = (uint8_t)data[2];
+
+    uint32_t pos = 3;
+
+    ///0 is a repeat, negative is one that's turned up late
+    int8_t seq_diff = (int8_t)(uint8_t)(seq - stream.last_seq);
+
+    ///a keyframe's always good, other than a repeat. After a long enough gap seq has wrapped and it might look old
+    if(kind == delta_kind::KEYFRAME)
+    {
+        if(len - pos < num_fields)
+            return false;
+
+        if(stream.have_keyframe && seq_diff == 0)
+            return false;
+
+        std::vector<uint8_t> sizes(data + pos, data + pos + num_fields);
+
+        pos += num_fields;
+
+        uint32_t num_bytes = 0;
+
+        for(uint8_t s : sizes)
+            num_bytes += s;
+
+        if(len - pos < num_bytes)
+            return false;
+
+        state.assign(data + pos, data + pos + num_bytes);
+
+        stream.sizes = sizes;
+        stream.last_seq = seq;
+        stream.have_keyframe = true;
+        stream.num_missed = 0;
+        stream.resync_due = false;
+
+        return true;
+    }
+
+    if(kind != delta_kind::DELTA)
+        return false;
+
+    if(!stream.have_keyframe)
+    {
+        delta_count_missed(stream);
+        return false;
+    }
+
+    if(seq_diff <= 0)
+        return false;
+
+    if(seq_diff != 1 || num_fields != stream.sizes.size())
+    {
+        stream.have_keyframe = false;
+
+        delta_count_missed(stream);
+        return false;
+    }
+
+    uint32_t mask_bytes = (num_fields + 7) / 8;
+
+    if(len - pos < mask_bytes)
+        return false;
+
+    const uint8_t* mask = (const uint8_t*)data + pos;
+
+    pos += mask_bytes;
+
+    ///check it's all there before changing anything
+    uint32_t needed = 0;
+
+    for(uint32_t i=0; i<num_fields; i++)
+    {
+        if(mask[i / 8] & (1 << (i % 8)))
+            needed += stream.sizes[i];
+    }
+
+    if(len - pos < needed)
+        return false;
+
+    uint32_t field_start = 0;
+
+    for(uint32_t i=0; i<num_fields; i++)
+    {
+        uint32_t size = stream.sizes[i];
+
+        if(mask[i / 8] & (1 << (i % 8)))
+        {
+            std::copy(data + pos, data + pos + size, state.begin() + field_start);
+
+            pos += size;
+        }
+
+        field_start += size;
+    }
+
+    stream.last_seq = seq;
+
+    return true;
+}
+
+///sending side, one per host entity
+struct delta_encoder
+{
+    std::vector<char> baseline;
+    std::vector<uint8_t> sizes;
+
+    uint8_t seq = 0;
+
+    ///deltas sent since the last keyframe, -1 means we've never sent anything
+    int updates_since_keyframe = -1;
+    int keyframe_interval = 60;
+
+    ///updates with nothing to send since we last sent something
+    int updates_since_sent = 0;
+    ///well inside the server's relayed_entity_timeout_ms at any sensible network rate
+    int idle_keyframe_interval = 120;
+
+    ///someone's lost track of us, see delta_kind::RESYNC
+    bool resync_requested = false;
+
+    ///false if there's nothing to send, or state can't be sent
+    bool encode(const delta_fields& state, byte_vector& out)
+    {
+        const std::vector<char>& bytes = state.vec.ptr;
+
+        if(!state.ok)
+            return false;
+
+        if(state.sizes.size() > 255)
+        {
+            printf("delta_encoder can't encode %i fields\n", (int)state.sizes.size());
+            return false;
+        }
+
+        bool keyframe = updates_since_keyframe < 0 ||
+                        updates_since_keyframe >= keyframe_interval ||
+                        updates_since_sent >= idle_keyframe_interval ||
+                        resync_requested ||
+                        sizes != state.sizes ||
+                        baseline.size() != bytes.size();
+
+        if(keyframe)
+        {
+            seq++;
+
+            delta_push_keyframe(out, seq, state.sizes, bytes);
+
+            baseline = bytes;
+            sizes = state.sizes;
+            updates_since_keyframe = 0;
+            updates_since_sent = 0;
+            resync_requested = false;
+
+            return true;
+        }
+
+        int num_fields = sizes.size();
+
+        std::vector<uint8_t> mask;
+        mask.resize((num_fields + 7) / 8);
+
+        bool any = false;
+
+        uint32_t field_start = 0;
+
+        for(int i=0; i<num_fields; i++)
+        {
+            uint32_t size = sizes[i];
+
+            if(!std::equal(bytes.begin() + field_start, bytes.begin() + field_start + size, baseline.begin() + field_start))
+            {
+                mask[i / 8] |= 1 << (i % 8);
+                any = true;
+            }
+
+            field_start += size;
+        }
+
+        if(!any)
+        {
+            updates_since_sent++;
+            return false;
+        }
+
+        seq++;
+
+        updates_since_keyframe++;
+        updates_since_sent = 0;
+
+        out.push_back<uint8_t>(delta_kind::DELTA);
+        out.push_back<uint8_t>(seq);
+        out.push_back<uint8_t>(num_fields);
+
+        for(uint8_t m : mask)
+        {
+            out.push_back<uint8_t>(m);
+        }
+
+        field_start = 0;
+
+        for(int i=0; i<num_fields; i++)
+        {
+            uint32_t size = sizes[i];
+
+            if(mask[i / 8] & (1 << (i % 8)))
+            {
+                out.ptr.insert(out.ptr.end(), bytes.begin() + field_start, bytes.begin() + field_start + size);
+
+                std::copy(bytes.begin() + field_start, bytes.begin() + field_start + size, baseline.begin() + field_start);
+            }
+
+            field_start += size;
+        }
+
+        return true;
+    }
+};
+
+#endif // DELTA_SHARED_HPP_INCLUDED
@@ -0,0 +1,210 @@
+#ifndef FRAME_SCHEDULER_SHARED_HPP_INCLUDED
+#define FRAME_SCHEDULER_SHARED_HPP_INCLUDED
+
+#include <SFML/System.hpp>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <stdio.h>
+
+///paces the client and server loops. Each thing the loop does gets a rate, wait() sleeps until the
+///earliest deadline, and due(id) says whether that thing should run this time round
+///
+///sleeping is sf::sleep (which asks windows for 1ms timer resolution) until spin_us before the deadline,
+///then yielding until we're there, so we wake up within a few tens of microseconds instead of whenever
+///the os gets round to it
+
+inline
+int64_t scheduler_now_us()
+{
+    static sf::Clock clk;
+
+    return clk.getElapsedTime().asMicroseconds();
+}
+
+///fixed width buckets, anything past the end goes in the last one
+struct latency_histogram
+{
+    static constexpr int64_t bucket_us = 250;
+    static constexpr int num_buckets = 400;
+
+    uint32_t buckets[num_buckets] = {0};
+
+    uint32_t count = 0;
+    int64_t total_us = 0;
+    int64_t max_us = 0;
+
+    void add(int64_t us)
+    {
+        if(us < 0)
+            us = 0;
+
+        int bucket = us / bucket_us;
+
+        if(bucket >= num_buckets)
+            bucket = num_buckets - 1;
+
+        buckets[bucket]++;
+
+        count++;
+        total_us += us;
+
+        if(us > max_us)
+            max_us = us;
+    }
+
+    void reset()
+    {
+        *this = latency_histogram();
+    }
+
+    float mean_ms() const
+    {
+        if(count == 0)
+            return 0.f;
+
+        return (total_us / (float)count) / 1000.f;
+    }
+
+    float max_ms() const
+    {
+        return max_us / 1000.f;
+    }
+
+    ///upper edge of the bucket the fraction'th sample is in, so it errs high
+    float percentile_ms(float fraction) const
+    {
+        if(count == 0)
+            return 0.f;
+
+        uint32_t target = (uint32_t)(fraction * count);
+        uint32_t seen = 0;
+
+        for(int i=0; i<num_buckets; i++)
+        {
+            seen += buckets[i];
+
+            if(seen > target)
+                return ((i + 1) * bucket_us) / 1000.f;
+        }
+
+        return max_ms();
+    }
+
+    void print(const char* name) const
+    {
+        printf("%s: %u samples, mean %.2fms, p50 %.2fms, p99 %.2fms, max %.2fms\n", name, count, mean_ms(), percentile_ms(0.5f), percentile_ms(0.99f), max_ms());
+    }
+};
+
+struct scheduled_rate
+{
+    ///0 or less means every time round the loop
+    float hz = 0;
+
+    int64_t next_us = 0;
+
+    int64_t period_us() const
+    {
+        if(hz <= 0)
+            return 0;
+
+        return (int64_t)(1000000.f / hz);
+    }
+};
+
+struct frame_scheduler
+{
+    std::vector<scheduled_rate> rates;
+
+    ///how far past the deadline wait() actually woke up
+    latency_histogram lateness;
+
+    ///client only. Sampling input -> the state it caused going out on the network
+    latency_histogram input_to_send;
+    ///client only. A packet arriving -> the first frame drawn after it going on screen
+    latency_histogram receive_to_render;
+
+    ///how close to the deadline we stop sleeping and start yielding
+    int64_t spin_us = 200;
+
+    int add_rate(float hz)
+    {
+        scheduled_rate rate;
+        rate.hz = hz;
+        rate.next_us = scheduler_now_us();
+
+        rates.push_back(rate);
+
+        return rates.size() - 1;
+    }
+
+    void set_rate(int id, float hz)
+    {
+        rates[id].hz = hz;
+        rates[id].next_us = scheduler_now_us();
+    }
+
+    ///if it is, the next deadline is one period on from this one so we don't drift
+    ///if we've fallen more than a couple of periods behind we skip ahead instead of running it back to back to catch up
+    bool due(int id)
+    {
+        scheduled_rate& rate = rates[id];
+
+        int64_t now = scheduler_now_us();
+
+        if(now < rate.next_us)
+            return false;
+
+        int64_t period = rate.period_us();
+
+        rate.next_us += period;
+
+        if(now - rate.next_us > period * 2)
+            rate.next_us = now + period;
+
+        return true;
+    }
+
+    int64_t next_deadline_us() const
+    {
+        int64_t earliest = INT64_MAX;
+
+        for(const scheduled_rate& rate : rates)
+        {
+            earliest = std::min(earliest, rate.next_us);
+        }
+
+        return earliest;
+    }
+
+    void sleep_until(int64_t deadline_us)
+    {
+        while(1)
+        {
+            int64_t left = deadline_us - scheduler_now_us();
+
+            if(left <= 0)
+                return;
+
+            if(left > spin_us)
+                sf::sleep(sf::microseconds(left - spin_us));
+            else
+                sf::sleep(sf::Time::Zero);
+        }
+    }
+
+    void wait()
+    {
+        int64_t deadline = next_deadline_us();
+
+        if(deadline == INT64_MAX)
+            return;
+
+        sleep_until(deadline);
+
+        lateness.add(scheduler_now_us() - deadline);
+    }
+};
+
+#endif // FRAME_SCHEDULER_SHARED_HPP_INCLUDED
@@ -1,6 +1,9 @@
 #include "game_state.hpp"
 #include "../master_server/network_messages.hpp"
 #include "../packet_clumping_shared.hpp"
+#include "../wire_v2_shared.hpp"
+#include "../delta_shared.hpp"
+#include "../quantise_shared.hpp"
 
 void server_reliability_manager::tick(server_game_state* state)
 {
@@ -277,6 +280,290 @@ void server_game_state::broadcast_clump(const std::vector<char>& dat, sockaddr_s
         printf("ip conflict bclp");
 }
 
+void server_game_state::send_forwarding(player& play, const std::vector<char>& payload)
+{
+    if(play.protocol_version < 2)
+    {
+        send_forwarding_v1(play, payload);
+        return;
+    }
+
+    std::vector<char> v2;
+    wire_v2_push_message(v2, message::FORWARDING, payload.data(), payload.size());
+
+    packet_clump.add_send_data(play.sock, play.store, v2, 2);
+
+    num_relayed++;
+}
+
+///the framing's how clients tell a v1 payload from a v2 one, so this goes to v2 players as is too
+void server_game_state::send_forwarding_v1(player& play, const std::vector<char>& payload)
+{
+    byte_vector vec;
+    vec.push_back(canary_start);
+    vec.push_back(message::FORWARDING);
+    vec.push_back<uint32_t>(payload.size());
+    vec.ptr.insert(vec.ptr.end(), payload.begin(), payload.end());
+    vec.push_back(canary_end);
+
+    packet_clump.add_send_data(play.sock, play.store, vec.ptr, 1);
+
+    num_relayed++;
+}
+
+///v1 forwarding is an entity's whole state (or an event) in raw floats, see network_serialisable::serialise_network_v1
+///
+///from a v1 player (an older build, or a newer one that's still agreeing a version) it goes to everyone, the same as
+///it always did. Newer builds read v1 as well as v2
+///from a v2 player it's the copy they send for older builds while there are any (see broadcast_legacy_peers),
+///and the v2 players already got the v2 version through broadcast_forwarding
+void server_game_state::relay_v1_forwarding(const std::vector<char>& payload, sockaddr_storage& to_skip)
+{
+    int32_t sender_pos = get_pos_from_player_id(sockaddr_to_playerid(to_skip));
+
+    bool from_v2 = sender_pos >= 0 && player_list[sender_pos].protocol_version >= 2;
+
+    for(player& play : player_list)
+    {
+        if(play.store == to_skip)
+            continue;
+
+        if(from_v2 && play.protocol_version >= 2)
+            continue;
+
+        send_forwarding_v1(play, payload);
+    }
+}
+
+///v2 players' entities only send the v1 format as well while someone needs it, so they're told how many need it
+void server_game_state::broadcast_legacy_peers()
+{
+    static sf::Clock clk;
+
+    ///once per second
+    float broadcast_every_ms = 1000.f;
+
+    if(clk.getElapsedTime().asMicroseconds() / 1000.f < broadcast_every_ms)
+        return;
+
+    clk.restart();
+
+    int32_t num_v1 = 0;
+
+    for(player& play : player_list)
+    {
+        if(play.protocol_version < 2)
+            num_v1++;
+    }
+
+    for(player& play : player_list)
+    {
+        if(play.protocol_version < 2)
+            continue;
+
+        byte_vector vec;
+        vec.push_back(canary_start);
+        vec.push_back(message::LEGACY_PEERS);
+        vec.push_back<int32_t>(num_v1);
+        vec.push_back(canary_end);
+
+        packet_clump.add_send_data(play.sock, play.store, vec.ptr, 1);
+    }
+}
+
+bool server_game_state::in_interest(const player& play, const relayed_entity& ent)
+{
+    ///don't know, so be safe
+    if(!play.has_view || !ent.has_pos)
+        return true;
+
+    int margin_x = (play.view_br.x() - play.view_tl.x()) * interest_margin;
+    int margin_y = (play.view_br.y() - play.view_tl.y()) * interest_margin;
+
+    return ent.pos.x() >= play.view_tl.x() - margin_x && ent.pos.x() <= play.view_br.x() + margin_x &&
+           ent.pos.y() >= play.view_tl.y() - margin_y && ent.pos.y() <= play.view_br.y() + margin_y;
+}
+
+///messages from an entity's owner are its state, delta encoded (see delta_shared.hpp). We keep our own copy of that
+///to know where it is, and so that anyone we've skipped can be sent a keyframe of where it is now rather than a
+///delta against something they never got
+///
+///events about an entity (eg damage from someone who hit it), and resyncs from someone who lost track of it,
+///are for its owner, so only the owner gets them
+///
+///this is only ever v2 forwarding, which v1 players can't read. They get the v1 copy, see relay_v1_forwarding
+void server_game_state::broadcast_forwarding(const std::vector<char>& payload, sockaddr_storage& to_skip)
+{
+    ///network_variable, 3 int16s
+    const uint32_t header_size = sizeof(int16_t) * 3;
+
+    if(payload.size() < header_size)
+        return;
+
+    int16_t owner = 0;
+    int16_t object_id = 0;
+    int16_t system_id = 0;
+
+    memcpy(&owner, &payload[0], sizeof(int16_t));
+    memcpy(&object_id, &payload[2], sizeof(int16_t));
+    memcpy(&system_id, &payload[4], sizeof(int16_t));
+
+    int32_t sender = sockaddr_to_playerid(to_skip);
+
+    bool is_event = delta_is_event(&payload[header_size], payload.size() - header_size);
+
+    ///nothing to tell anyone
+    if(owner == sender && is_event)
+        return;
+
+    if(owner != sender)
+    {
+        int32_t arr_pos = get_pos_from_player_id(owner);
+
+        if(arr_pos < 0 || player_list[arr_pos].protocol_version < 2)
+            return;
+
+        send_forwarding(player_list[arr_pos], payload);
+        return;
+    }
+
+    float now = running_time.getElapsedTime().asMicroseconds() / 1000.f;
+
+    uint64_t key = ((uint64_t)(uint16_t)owner << 32) | ((uint64_t)(uint16_t)object_id << 16) | (uint16_t)system_id;
+
+    relayed_entity& ent = relayed_entities[key];
+
+    ent.owner = owner;
+    ent.last_update_ms = now;
+
+    wire_quantiser& quant = get_wire_quantiser();
+
+    if(delta_apply(&payload[header_size], payload.size() - header_size, ent.state, ent.stream) && ent.state.size() >= quant.pos_bytes())
+    {
+        byte_fetch fetch;
+        fetch.ptr = ent.state;
+
+        ent.pos = quant.get_quantised_pos(fetch);
+        ent.has_pos = true;
+    }
+
+    ///only built if someone needs it
+    std::vector<char> keyframe;
+
+    int c = 0;
+
+    for(int i=0; i<player_list.size(); i++)
+    {
+        player& play = player_list[i];
+
+        if(play.store == to_skip)
+        {
+            c++;
+            continue;
+        }
+
+        if(play.protocol_version < 2)
+            continue;
+
+        relayed_entity::recipient& rec = ent.recipients[play.id];
+
+        if(!in_interest(play, ent) && now - rec.last_sent_ms < distant_interval_ms)
+        {
+            rec.stale = true;
+            num_relay_skipped++;
+            continue;
+        }
+
+        rec.last_sent_ms = now;
+
+        if(!rec.stale)
+        {
+            send_forwarding(play, payload);
+            continue;
+        }
+
+        ///we can't help them until we've got a keyframe ourselves, so they stay stale
+        if(!ent.stream.have_keyframe)
+        {
+            send_forwarding(play, payload);
+            continue;
+        }
+
+        if(keyframe.size() == 0)
+        {
+            byte_vector vec;
+            vec.ptr.insert(vec.ptr.end(), payload.begin(), payload.begin() + header_size);
+
+            delta_push_keyframe(vec, ent.stream.last_seq, ent.stream.sizes, ent.state);
+
+            keyframe = vec.ptr;
+        }
+
+        send_forwarding(play, keyframe);
+
+        rec.stale = false;
+    }
+
+    if(c > 1)
+        printf("ip conflict bfwd");
+}
+
+void server_game_state::process_view_region(const char* data, uint32_t len, sockaddr_storage& who)
+{
+    wire_quantiser& quant = get_wire_quantiser();
+
+    if(len < quant.pos_bytes() * 2)
+        return;
+
+    int32_t arr_pos = get_pos_from_player_id(sockaddr_to_playerid(who));
+
+    if(arr_pos < 0)
+        return;
+
+    player& play = player_list[arr_pos];
+
+    byte_fetch fetch;
+    fetch.ptr.assign(data, data + len);
+
+    play.view_tl = quant.get_quantised_pos(fetch);
+    play.view_br = quant.get_quantised_pos(fetch);
+    play.has_view = true;
+}
+
+///entities keep sending keyframes even when nothing changes, so one that's gone quiet has gone
+void server_game_state::cull_relayed_entities()
+{
+    static sf::Clock clk;
+
+    if(clk.getElapsedTime().asMilliseconds() < 1000)
+        return;
+
+    clk.restart();
+
+    float now = running_time.getElapsedTime().asMicroseconds() / 1000.f;
+
+    for(auto it = relayed_entities.begin(); it != relayed_entities.end();)
+    {
+        relayed_entity& ent = it->second;
+
+        if(now - ent.last_update_ms > relayed_entity_timeout_ms || get_pos_from_player_id(ent.owner) < 0)
+        {
+            it = relayed_entities.erase(it);
+            continue;
+        }
+
+        for(auto rit = ent.recipients.begin(); rit != ent.recipients.end();)
+        {
+            if(get_pos_from_player_id(rit->first) < 0)
+                rit = ent.recipients.erase(rit);
+            else
+                ++rit;
+        }
+
+        ++it;
+    }
+}
+
 #if 0
 void server_game_state::tick_all()
 {
@@ -489,25 +776,18 @@ void server_game_state::process_received_message(byte_fetch& arg, sockaddr_stora
         vec.push_back<uint8_t>(fetch.get<uint8_t>());
     }*/
 
-    byte_vector vec;
-    vec.push_back(canary_start);
-
-    vec.push_back(message::FORWARDING);
-
     uint32_t len = fetch.get<uint32_t>();
 
     if(len > 255)
         len = 255;
 
-    vec.push_back<uint32_t>(len);
+    std::vector<char> payload;
 
     for(int i=0; i<len; i++)
     {
-        vec.push_back(fetch.get<uint8_t>());
+        payload.push_back(fetch.get<uint8_t>());
     }
 
-    vec.push_back(canary_end);
-
     int32_t found_end = fetch.get<int32_t>();
 
     ///rewind
@@ -519,7 +799,77 @@ void server_game_state::process_received_message(byte_fetch& arg, sockaddr_stora
 
     arg = fetch;
 
-    broadcast_clump(vec.ptr, who);
+    relay_v1_forwarding(payload, who);
+}
+
+///v2 has no canaries to check, the crc covers the lot. Message types we don't know are skipped
+void server_game_state::process_v2_datagram(const std::vector<char>& data, sockaddr_storage& who)
+{
+    wire_v2_reader reader(data.data(), data.size());
+
+    if(!reader.valid)
+    {
+        printf("dropped a bad v2 datagram\n");
+        return;
+    }
+
+    uint8_t type = 0;
+    uint32_t offset = 0;
+    uint32_t len = 0;
+
+    while(reader.next(type, offset, len))
+    {
+        if(type == message::VIEW_REGION)
+        {
+            process_view_region(&data[offset], len, who);
+            continue;
+        }
+
+        if(type != message::FORWARDING)
+            continue;
+
+        ///same limit as v1
+        if(len > 255)
+            continue;
+
+        std::vector<char> payload(data.begin() + offset, data.begin() + offset + len);
+
+        broadcast_forwarding(payload, who);
+    }
+}
+
+void server_game_state::process_protocol_version(udp_sock& my_server, byte_fetch& fetch, sockaddr_storage& who)
+{
+    int32_t offered = fetch.get<int32_t>();
+
+    int32_t found_end = fetch.get<int32_t>();
+
+    if(found_end != canary_end)
+        return;
+
+    int32_t arr_pos = get_pos_from_player_id(sockaddr_to_playerid(who));
+
+    if(arr_pos < 0)
+        return;
+
+    player& play = player_list[arr_pos];
+
+    play.protocol_version = std::min(std::max(offered, 1), WIRE_VERSION);
+
+    byte_vector vec;
+    vec.push_back(canary_start);
+    vec.push_back(message::PROTOCOL_VERSION);
+    vec.push_back<int32_t>(play.protocol_version);
+
+    ///everyone's relaying each other's state, so they all have to quantise it the same way as us
+    if(play.protocol_version >= 2)
+        get_wire_quantiser().push_settings(vec);
+
+    vec.push_back(canary_end);
+
+    udp_send_to(my_server, vec.ptr, (const sockaddr*)&who);
+
+    printf("Player %i using protocol v%i\n", play.id, play.protocol_version);
 }
 
 void server_game_state::process_reported_message(byte_fetch& arg, sockaddr_storage& who)
@@ -12,6 +12,7 @@
 #include "../reliability_shared.hpp"
 #include "../packet_clumping_shared.hpp"
 #include "../game_mode_shared.hpp"
+#include "../delta_shared.hpp"
 
 struct player
 {
@@ -35,6 +36,42 @@ struct player
     udp_sock sock;
     sockaddr_storage store;
     sf::Clock time_since_last_message;
+
+    ///what forwarded messages are framed as on the way to them, agreed with PROTOCOL_VERSION
+    ///v1 players only ever get v1 forwarding, v2 players get both (see relay_v1_forwarding)
+    int protocol_version = 1;
+
+    ///quantised (see wire_quantiser), from VIEW_REGION. v1 clients never send one and get everything
+    bool has_view = false;
+    vec2i view_tl;
+    vec2i view_br;
+};
+
+///what the server knows about an entity from relaying its owner's updates
+struct relayed_entity
+{
+    int32_t owner = -1;
+
+    ///the owner's delta stream decoded, see delta_shared.hpp
+    std::vector<char> state;
+    delta_stream stream;
+
+    ///quantised
+    vec2i pos;
+    bool has_pos = false;
+
+    float last_update_ms = 0;
+
+    struct recipient
+    {
+        float last_sent_ms = 0;
+
+        ///they've been skipped since they were last sent anything, so the deltas they've got aren't enough
+        bool stale = true;
+    };
+
+    ///player id -> how they're doing
+    std::map<int32_t, recipient> recipients;
 };
 
 ///modify this to have player_id_reported_as_killer
@@ -96,6 +133,19 @@ struct server_game_state
 {
     packet_clumper packet_clump;
 
+    ///keyed the same way as the client's network_inbox
+    std::map<uint64_t, relayed_entity> relayed_entities;
+
+    ///things this far outside a player's view (as a fraction of its size) are still relayed every time
+    float interest_margin = 0.5f;
+    ///anything further away still gets relayed this often, so nothing's ever entirely missing
+    float distant_interval_ms = 250;
+    float relayed_entity_timeout_ms = 5000;
+
+    ///running totals for -stats
+    uint64_t num_relayed = 0;
+    uint64_t num_relay_skipped = 0;
+
     server_reliability_manager reliable;
 
     int max_players = 10;
@@ -134,6 +184,14 @@ struct server_game_state
     void broadcast(const std::vector<char>& dat, const int& to_skip);
     void broadcast(const std::vector<char>& dat, sockaddr_storage& to_skip);
     void broadcast_clump(const std::vector<char>& dat, sockaddr_storage& to_skip);
+    ///payload is the network_variable and what the entity sent, framed for each player's protocol version
+    void broadcast_forwarding(const std::vector<char>& payload, sockaddr_storage& to_skip);
+    void relay_v1_forwarding(const std::vector<char>& payload, sockaddr_storage& to_skip);
+    void send_forwarding(player& play, const std::vector<char>& payload);
+    void send_forwarding_v1(player& play, const std::vector<char>& payload);
+    void broadcast_legacy_peers();
+    bool in_interest(const player& play, const relayed_entity& ent);
+    void cull_relayed_entities();
 
     void cull_disconnected_players();
     void add_player(udp_sock& sock, sockaddr_storage store);
@@ -148,6 +206,9 @@ struct server_game_state
     void tick();
 
     void process_received_message(byte_fetch& fetch, sockaddr_storage& who);
+    void process_v2_datagram(const std::vector<char>& data, sockaddr_storage& who);
+    void process_protocol_version(udp_sock& sock, byte_fetch& fetch, sockaddr_storage& who);
+    void process_view_region(const char* data, uint32_t len, sockaddr_storage& who);
     void process_reported_message(byte_fetch& fetch, sockaddr_storage& who);
     void process_join_request(udp_sock& sock, byte_fetch& fetch, sockaddr_storage& who);
     void process_respawn_request(udp_sock& sock, byte_fetch& fetch, sockaddr_storage& who);
@@ -5,6 +5,8 @@
 #include "../master_server/network_messages.hpp"
 #include <vec/vec.hpp>
 #include "game_state.hpp"
+#include "../frame_scheduler_shared.hpp"
+#include "../wire_v2_shared.hpp"
 
 #include <cl/cl.h>
 
@@ -93,6 +95,11 @@ int main(int argc, char* argv[])
 
     std::string host_port = GAMESERVER_PORT;
 
+    ///packets only get read once a tick, so this bounds how long they sit in the socket
+    float tick_rate = 1000.f;
+
+    bool print_stats = false;
+
     for(int i=1; i<argc; i++)
     {
         if(strncmp(argv[i], "-port", strlen("-port")) == 0)
@@ -102,6 +109,19 @@ int main(int argc, char* argv[])
                 host_port = argv[i+1];
             }
         }
+
+        if(strncmp(argv[i], "-tickrate", strlen("-tickrate")) == 0)
+        {
+            if(i + 1 < argc)
+            {
+                tick_rate = atof(argv[i+1]);
+            }
+        }
+
+        if(strncmp(argv[i], "-stats", strlen("-stats")) == 0)
+        {
+            print_stats = true;
+        }
     }
 
     uint32_t pnum = atoi(host_port.c_str());
@@ -122,8 +142,18 @@ int main(int argc, char* argv[])
 
     bool going = true;
 
+    frame_scheduler scheduler;
+    int tick_id = scheduler.add_rate(tick_rate);
+
+    sf::Clock stats_clk;
+
     while(going)
     {
+        scheduler.wait();
+
+        if(!scheduler.due(tick_id))
+            continue;
+
         ping_master(my_state, pnum, to_master);
 
         /*if(sock_readable(to_server))
@@ -170,6 +200,15 @@ int main(int argc, char* argv[])
 
             any_read = data.size() > 0;
 
+            if(wire_is_v2(data.data(), data.size()))
+            {
+                my_state.process_v2_datagram(data, store);
+
+                my_state.reset_player_disconnect_timer(store);
+
+                continue;
+            }
+
             byte_fetch fetch;
             fetch.ptr.swap(data);
 
@@ -236,6 +275,10 @@ int main(int argc, char* argv[])
                 {
                     my_state.process_ping_gameserver(my_server, fetch, store);
                 }
+                else if(type == message::PROTOCOL_VERSION)
+                {
+                    my_state.process_protocol_version(my_server, fetch, store);
+                }
                 else
                 {
                     printf("err %i ", type);
@@ -257,9 +300,6 @@ int main(int argc, char* argv[])
                 ///client pushing data to other clients
         }
 
-        sf::sleep(sf::milliseconds(1));
-
-
         //my_state.tick();
 
         my_state.balance_teams();
@@ -274,6 +314,10 @@ int main(int argc, char* argv[])
 
         my_state.cull_disconnected_players();
 
+        my_state.cull_relayed_entities();
+
+        my_state.broadcast_legacy_peers();
+
         my_state.reliable.tick(&my_state);
 
         ///should do tick ping
@@ -287,5 +331,18 @@ int main(int argc, char* argv[])
         my_state.broadcast_ping_data();
 
         my_state.packet_clump.tick();
+
+        if(print_stats && stats_clk.getElapsedTime().asSeconds() >= 10)
+        {
+            scheduler.lateness.print("Tick lateness");
+            scheduler.lateness.reset();
+
+            printf("Relayed %llu entity messages, skipped %llu out of view, tracking %i entities\n", (unsigned long long)my_state.num_relayed, (unsigned long long)my_state.num_relay_skipped, (int)my_state.relayed_entities.size());
+
+            my_state.num_relayed = 0;
+            my_state.num_relay_skipped = 0;
+
+            stats_clk.restart();
+        }
     }
 }
@@ -47,6 +47,9 @@ namespace message
         PING_GAMESERVER,
         PING_GAMESERVER_RESPONSE,
         PLAYER_STATS_UPDATE_INDIVIDUAL, ///kills, deaths for a player
+        PROTOCOL_VERSION, ///int32 version. Client offers its highest, server answers with the one to use, then from v2 on wire_quantiser::push_settings
+        VIEW_REGION, ///v2 only, client -> server. Quantised top left and bottom right of what the client can see
+        LEGACY_PEERS, ///server -> v2 clients, int32 number of v1 players. Entities send v1 as well while it's not 0
     };
 }
 
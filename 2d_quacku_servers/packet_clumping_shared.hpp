@@ -4,12 +4,16 @@
 #include <net/shared.hpp>
 #include <map>
 #include <vector>
+#include "wire_v2_shared.hpp"
 
 struct net_dest
 {
     udp_sock sock;
     sockaddr_storage store;
     std::vector<char> data;
+
+    ///v2 data is bare messages, tick puts the datagram header on
+    int version = 1;
 };
 
 struct net_info
@@ -24,9 +28,9 @@ struct packet_clumper
     std::vector<net_dest> destination_to_senddata;
     std::vector<net_info> destinations;
 
-    void add_send_data(udp_sock& sock, sockaddr_storage& store, const std::vector<char>& dat)
+    void add_send_data(udp_sock& sock, sockaddr_storage& store, const std::vector<char>& dat, int version = 1)
     {
-        net_dest dest = {sock, store, dat};
+        net_dest dest = {sock, store, dat, version};
 
         destination_to_senddata.push_back(dest);
 
@@ -45,17 +49,37 @@ struct packet_clumper
     {
         for(auto& i : destinations)
         {
+            ///v1 and v2 can't share a datagram
             std::vector<char> data;
+            std::vector<char> data_v2;
 
             for(auto& nd : destination_to_senddata)
             {
-                if(i.store == nd.store)
+                if(!(i.store == nd.store))
+                    continue;
+
+                if(nd.version >= 2)
+                {
+                    if(data_v2.size() == 0)
+                        wire_v2_begin(data_v2);
+
+                    data_v2.insert(data_v2.end(), nd.data.begin(), nd.data.end());
+                }
+                else
                 {
                     data.insert(data.end(), nd.data.begin(), nd.data.end());
                 }
             }
 
-            udp_send_to(i.sock, data, (sockaddr*)&i.store);
+            if(data.size() > 0)
+                udp_send_to(i.sock, data, (sockaddr*)&i.store);
+
+            if(data_v2.size() > 0)
+            {
+                wire_v2_finish(data_v2);
+
+                udp_send_to(i.sock, data_v2, (sockaddr*)&i.store);
+            }
         }
 
         destination_to_senddata.clear();
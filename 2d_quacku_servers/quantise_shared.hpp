@@ -0,0 +1,203 @@
+#ifndef QUANTISE_SHARED_HPP_INCLUDED
+#define QUANTISE_SHARED_HPP_INCLUDED
+
+#include <vec/vec.hpp>
+#include <stdint.h>
+#include <math.h>
+#include <algorithm>
+#include <stdio.h>
+
+///fixed point versions of what entities send each other, so an update's a handful of bytes instead of floats and int32s
+///everyone has to agree on the bounds, pos_bits, hp_range and damage_scale, rather than go by whatever map (or version
+///of a map) they happen to have loaded. The server's are the ones that count: it sends them with its PROTOCOL_VERSION
+///answer (push_settings), and a client takes them on (get_settings) before it sends or reads any entities. The values
+///here are the defaults a server starts with
+///
+///what you get back on the other end:
+///
+///pos: anything inside the bounds comes back within half a step, a step being (br - tl) / (2^pos_bits - 1) on each axis.
+///     Anything outside is clamped to the edge. The corners come back exactly
+///     pos_bits is 1 to 20. Up to 16 is 4 bytes, more is 5 (the top 4 bits of x and y share a byte)
+///hp: a byte, 0 -> hp_range. Within half of hp_range / 255, except that 0 is only ever 0 and hp_range is only ever hp_range,
+///    so dead() and full health come back exactly. Negative hp sends as 0
+///damage: a uint16 of 1/damage_scale hp. Whatever gets rounded off is left for the caller to send next time
+///        (damageable_base does), so over time the total is exact to within 1/damage_scale, it's just not all on time.
+///        Anything over 65535 / damage_scale in one update is sent in several
+///flags: booleans get a bit each in a uint8, exact
+///
+///every host entity's state starts with its pos, which is how the server knows where things are without knowing the map
+struct wire_quantiser
+{
+    ///with these bounds, at 20 bits a step is 1/16th of a unit, at 16 it's 1
+    vec2f tl = {-32768, -32768};
+    vec2f br = {32768, 32768};
+
+    int pos_bits = 20;
+
+    float hp_range = 1.f;
+
+    float damage_scale = 1024.f;
+
+    ///works on byte_vector
+    template<typename T>
+    void push_settings(T& vec) const
+    {
+        vec.template push_back<uint8_t>(pos_bits);
+        vec.template push_back<float>(tl.x());
+        vec.template push_back<float>(tl.y());
+        vec.template push_back<float>(br.x());
+        vec.template push_back<float>(br.y());
+        vec.template push_back<float>(hp_range);
+        vec.template push_back<float>(damage_scale);
+    }
+
+    ///works on byte_fetch. False, and nothing changes, if they're not something we can use
+    template<typename T>
+    bool get_settings(T& fetch)
+    {
+        int bits = fetch.template get<uint8_t>();
+
+        float tl_x = fetch.template get<float>();
+        float tl_y = fetch.template get<float>();
+        float br_x = fetch.template get<float>();
+        float br_y = fetch.template get<float>();
+
+        float nhp_range = fetch.template get<float>();
+        float ndamage_scale = fetch.template get<float>();
+
+        ///written so that nans fail too
+        bool valid = bits >= 1 && bits <= 20 &&
+                     br_x > tl_x && br_y > tl_y &&
+                     nhp_range > 0.f && ndamage_scale > 0.f;
+
+        if(!valid)
+        {
+            printf("Bad quantiser settings, %i bits\n", bits);
+            return false;
+        }
+
+        pos_bits = bits;
+        tl = {tl_x, tl_y};
+        br = {br_x, br_y};
+        hp_range = nhp_range;
+        damage_scale = ndamage_scale;
+
+        return true;
+    }
+
+    uint32_t max_pos() const
+    {
+        return (1u << pos_bits) - 1;
+    }
+
+    int pos_bytes() const
+    {
+        return pos_bits > 16 ? 5 : 4;
+    }
+
+    vec2f step() const
+    {
+        return (br - tl) / (float)max_pos();
+    }
+
+    uint32_t quantise_axis(float v, float lo, float hi) const
+    {
+        float frac = (v - lo) / (hi - lo);
+
+        frac = std::min(std::max(frac, 0.f), 1.f);
+
+        return (uint32_t)lrintf(frac * max_pos());
+    }
+
+    float unquantise_axis(uint32_t q, float lo, float hi) const
+    {
+        q = std::min(q, max_pos());
+
+        return lo + (hi - lo) * (q / (float)max_pos());
+    }
+
+    ///works on byte_vector
+    template<typename T>
+    void push_pos(T& vec, vec2f pos) const
+    {
+        uint32_t qx = quantise_axis(pos.x(), tl.x(), br.x());
+        uint32_t qy = quantise_axis(pos.y(), tl.y(), br.y());
+
+        vec.template push_back<uint16_t>(qx & 0xFFFF);
+        vec.template push_back<uint16_t>(qy & 0xFFFF);
+
+        if(pos_bits > 16)
+            vec.template push_back<uint8_t>((qx >> 16) | ((qy >> 16) << 4));
+    }
+
+    ///works on byte_fetch or net_view
+    ///0 -> max_pos on each axis, which is all the server ever sees of positions
+    template<typename T>
+    vec2i get_quantised_pos(T& fetch) const
+    {
+        uint32_t qx = fetch.template get<uint16_t>();
+        uint32_t qy = fetch.template get<uint16_t>();
+
+        if(pos_bits > 16)
+        {
+            uint8_t high = fetch.template get<uint8_t>();
+
+            qx |= (uint32_t)(high & 0xF) << 16;
+            qy |= (uint32_t)(high >> 4) << 16;
+        }
+
+        return {(int)qx, (int)qy};
+    }
+
+    template<typename T>
+    vec2f get_pos(T& fetch) const
+    {
+        vec2i q = get_quantised_pos(fetch);
+
+        return {unquantise_axis(q.x(), tl.x(), br.x()), unquantise_axis(q.y(), tl.y(), br.y())};
+    }
+
+    uint8_t quantise_hp(float hp) const
+    {
+        if(hp <= 0.f)
+            return 0;
+
+        if(hp >= hp_range)
+            return 255;
+
+        int q = (int)lrintf((hp / hp_range) * 255.f);
+
+        return std::min(std::max(q, 1), 254);
+    }
+
+    float unquantise_hp(uint8_t q) const
+    {
+        if(q == 255)
+            return hp_range;
+
+        return (q / 255.f) * hp_range;
+    }
+
+    ///how much of pending goes in this update. Take the returned amount off pending once it's sent
+    uint16_t quantise_damage(float pending) const
+    {
+        float q = floorf(pending * damage_scale + 0.5f);
+
+        return (uint16_t)std::min(std::max(q, 0.f), 65535.f);
+    }
+
+    float unquantise_damage(uint16_t q) const
+    {
+        return q / damage_scale;
+    }
+};
+
+inline
+wire_quantiser& get_wire_quantiser()
+{
+    static wire_quantiser quantiser;
+
+    return quantiser;
+}
+
+#endif // QUANTISE_SHARED_HPP_INCLUDED
@@ -0,0 +1,195 @@
+#ifndef WIRE_V2_SHARED_HPP_INCLUDED
+#define WIRE_V2_SHARED_HPP_INCLUDED
+
+#include <vector>
+#include <stdint.h>
+#include <string.h>
+
+///v2 datagrams are
+///
+///    uint16 WIRE_V2_MAGIC, uint8 version, uint32 crc32 of everything after the header
+///    then messages back to back: uint8 message type, varint payload length, payload
+///
+///v1 datagrams start with canary_start, so which one we've got is decided by the first bytes of each datagram and
+///both kinds can be in flight at once. There's nothing to resync on in v2: a bad crc drops the whole datagram,
+///and a message type we don't know is skipped by its length
+///
+///peers start off in v1. The client offers its version in a v1 PROTOCOL_VERSION message after joining, and the
+///server answers with the one they're going to use, and for v2 the quantiser settings to go with it. A server that's never heard of v2 ignores the offer, so
+///the client never gets an answer and stays on v1
+///
+///only FORWARDING goes in v2 so far, everything else is a few messages a second and is still v1
+///
+///the version covers what entities send as well as the framing. v2 entity state is delta encoded and quantised
+///(see delta_shared.hpp and quantise_shared.hpp), which a v1 build can't read. v1 forwarding is still the old whole
+///state in raw floats, and v2 builds read both. So a v2 client sends v1 until a v2 server answers, and after that
+///sends a v1 copy as well while the server says there are v1 players (LEGACY_PEERS). The server relays v1 from v1
+///players to everyone, the v1 copy only to v1 players, and v2 only to v2 players
+
+#define WIRE_V2_MAGIC 0x5751 ///QW
+#define WIRE_VERSION 2
+
+///magic + version + crc
+#define WIRE_V2_HEADER_SIZE 7
+
+inline
+uint32_t wire_crc32(const char* data, uint32_t len)
+{
+    static uint32_t table[256];
+    static bool init = false;
+
+    if(!init)
+    {
+        for(uint32_t i=0; i<256; i++)
+        {
+            uint32_t c = i;
+
+            for(int k=0; k<8; k++)
+                c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+
+            table[i] = c;
+        }
+
+        init = true;
+    }
+
+    uint32_t crc = 0xFFFFFFFF;
+
+    for(uint32_t i=0; i<len; i++)
+    {
+        crc = table[(crc ^ (uint8_t)data[i]) & 0xFF] ^ (crc >> 8);
+    }
+
+    return crc ^ 0xFFFFFFFF;
+}
+
+///7 bits at a time, low first, top bit set if there's more
+inline
+void wire_push_varint(std::vector<char>& out, uint32_t val)
+{
+    while(val >= 0x80)
+    {
+        out.push_back((char)((val & 0x7F) | 0x80));
+        val >>= 7;
+    }
+
+    out.push_back((char)val);
+}
+
+///false if it runs off the end or is longer than a uint32 can be
+inline
+bool wire_get_varint(const char* data, uint32_t len, uint32_t& pos, uint32_t& out)
+{
+    out = 0;
+
+    for(int shift=0; shift<35; shift += 7)
+    {
+        if(pos >= len)
+            return false;
+
+        uint8_t b = data[pos++];
+
+        out |= (uint32_t)(b & 0x7F) << shift;
+
+        if((b & 0x80) == 0)
+            return true;
+    }
+
+    return false;
+}
+
+///writes the header with a blank crc, wire_v2_finish fills it in
+inline
+void wire_v2_begin(std::vector<char>& out)
+{
+    uint16_t magic = WIRE_V2_MAGIC;
+    uint8_t version = WIRE_VERSION;
+    uint32_t crc = 0;
+
+    out.insert(out.end(), (const char*)&magic, (const char*)&magic + sizeof(magic));
+    out.insert(out.end(), (const char*)&version, (const char*)&version + sizeof(version));
+    out.insert(out.end(), (const char*)&crc, (const char*)&crc + sizeof(crc));
+}
+
+inline
+void wire_v2_push_message(std::vector<char>& out, uint8_t type, const char* payload, uint32_t len)
+{
+    out.push_back((char)type);
+
+    wire_push_varint(out, len);
+
+    out.insert(out.end(), payload, payload + len);
+}
+
+///out starts with the wire_v2_begin header
+inline
+void wire_v2_finish(std::vector<char>& out)
+{
+    if(out.size() < WIRE_V2_HEADER_SIZE)
+        return;
+
+    uint32_t crc = wire_crc32(&out[WIRE_V2_HEADER_SIZE], out.size() - WIRE_V2_HEADER_SIZE);
+
+    memcpy(&out[3], &crc, sizeof(crc));
+}
+
+///just looks at the magic, doesn't check anything
+inline
+bool wire_is_v2(const char* data, uint32_t len)
+{
+    if(len < WIRE_V2_HEADER_SIZE)
+        return false;
+
+    uint16_t magic = 0;
+    memcpy(&magic, data, sizeof(magic));
+
+    return magic == WIRE_V2_MAGIC;
+}
+
+///walks the messages in a v2 datagram. Construct it, check valid, then call next until it says no
+struct wire_v2_reader
+{
+    const char* data = nullptr;
+    uint32_t len = 0;
+    uint32_t pos = WIRE_V2_HEADER_SIZE;
+
+    bool valid = false;
+
+    wire_v2_reader(const char* pdata, uint32_t plen) : data(pdata), len(plen)
+    {
+        if(!wire_is_v2(data, len))
+            return;
+
+        uint8_t version = data[2];
+
+        if(version != WIRE_VERSION)
+            return;
+
+        uint32_t crc = 0;
+        memcpy(&crc, &data[3], sizeof(crc));
+
+        valid = crc == wire_crc32(&data[WIRE_V2_HEADER_SIZE], len - WIRE_V2_HEADER_SIZE);
+    }
+
+    ///offset is from the start of the datagram. False when there's nothing left, or what's left is garbage
+    bool next(uint8_t& type, uint32_t& offset, uint32_t& message_len)
+    {
+        if(!valid || pos >= len)
+            return false;
+
+        type = data[pos++];
+
+        if(!wire_get_varint(data, len, pos, message_len) || message_len > len - pos)
+        {
+            valid = false;
+            return false;
+        }
+
+        offset = pos;
+        pos += message_len;
+
+        return true;
+    }
+};
+
+#endif // WIRE_V2_SHARED_HPP_INCLUDED
@@ -0,0 +1,244 @@
+#ifndef BATCH_RENDERER_HPP_INCLUDED
+#define BATCH_RENDERER_HPP_INCLUDED
+
+#include <SFML/Graphics.hpp>
+#include <vector>
+#include <memory>
+#include <math.h>
+#include <vec/vec.hpp>
+
+///objects write their geometry in here instead of drawing it, and then everything with the same texture
+///gets drawn in one go. Untextured stuff goes in the nullptr texture batch
+///
+///flushing doesn't draw anything either, it hands the vertices to a render_snapshot, which is everything one frame draws
+///the render thread then draws snapshots, see render_thread.hpp
+///
+///every draw goes through draw_counted, so render_stats::draw_calls is every draw the game makes
+///draw a render_snapshot to a sf::RenderTexture and that's a headless backend you can count draws on
+
+struct render_stats
+{
+    int draw_calls = 0;
+    int vertices = 0;
+
+    void reset()
+    {
+        draw_calls = 0;
+        vertices = 0;
+    }
+};
+
+inline
+render_stats& get_render_stats()
+{
+    static render_stats stats;
+
+    return stats;
+}
+
+///anything entirely outside this doesn't get drawn
+struct cull_rect
+{
+    vec2f tl;
+    vec2f br;
+
+    ///world units per pixel
+    float zoom = 1.f;
+
+    cull_rect(const camera& cam)
+    {
+        cam.get_visible_rect(tl, br);
+
+        zoom = cam.zoom;
+    }
+
+    bool overlaps(vec2f otl, vec2f obr) const
+    {
+        return !(obr.x() < tl.x() || otl.x() > br.x() || obr.y() < tl.y() || otl.y() > br.y());
+    }
+};
+
+///corners go round the quad, uvs in texture pixels
+inline
+void append_quad(sf::VertexArray& verts, const vec2f corners[4], sf::Color col, const vec2f uvs[4] = nullptr)
+{
+    static const int order[6] = {0, 1, 2, 0, 2, 3};
+
+    for(int i : order)
+    {
+        sf::Vertex vert({corners[i].x(), corners[i].y()}, col);
+
+        if(uvs)
+            vert.texCoords = {uvs[i].x(), uvs[i].y()};
+
+        verts.append(vert);
+    }
+}
+
+///same as a sf::RectangleShape with this size, origin, position and rotation
+inline
+void append_rect(sf::VertexArray& verts, vec2f pos, vec2f dim, vec2f origin, float angle, sf::Color col)
+{
+    vec2f dx = {cosf(angle), sinf(angle)};
+    vec2f dy = {-sinf(angle), cosf(angle)};
+
+    vec2f tl = pos - dx * origin.x() - dy * origin.y();
+
+    vec2f corners[4] = {tl, tl + dx * dim.x(), tl + dx * dim.x() + dy * dim.y(), tl + dy * dim.y()};
+
+    append_quad(verts, corners, col);
+}
+
+///every draw goes through here so render_stats sees it
+inline
+void draw_counted(sf::RenderTarget& target, const sf::VertexArray& verts, const sf::RenderStates& states = sf::RenderStates::Default)
+{
+    if(verts.getVertexCount() == 0)
+        return;
+
+    target.draw(verts, states);
+
+    render_stats& stats = get_render_stats();
+
+    stats.draw_calls++;
+    stats.vertices += verts.getVertexCount();
+}
+
+///one draw. verts is never modified once it's in a snapshot, so snapshots can share them between threads
+struct render_layer
+{
+    std::shared_ptr<const sf::VertexArray> verts;
+    const sf::Texture* tex = nullptr;
+};
+
+///everything the simulation wants drawn for one frame, in draw order
+///nothing in here points back into the simulation except textures, which live in texture_cache
+struct render_snapshot
+{
+    sf::View view;
+
+    ///size of the window the view was made for
+    sf::Vector2u target_size;
+
+    std::vector<render_layer> layers;
+
+    ///scheduler_now_us of the oldest network data in this frame that's not been on screen before, or -1
+    int64_t receive_us = -1;
+
+    void clear()
+    {
+        layers.clear();
+        receive_us = -1;
+    }
+
+    void add(const std::shared_ptr<const sf::VertexArray>& verts, const sf::Texture* tex = nullptr)
+    {
+        if(verts == nullptr || verts->getVertexCount() == 0)
+            return;
+
+        layers.push_back({verts, tex});
+    }
+
+    void draw(sf::RenderTarget& target) const
+    {
+        target.setView(view);
+
+        for(const render_layer& layer : layers)
+        {
+            sf::RenderStates states;
+            states.texture = layer.tex;
+
+            draw_counted(target, *layer.verts, states);
+        }
+    }
+};
+
+struct render_batch
+{
+    const sf::Texture* tex = nullptr;
+
+    sf::VertexArray verts{sf::Triangles};
+};
+
+struct batch_renderer
+{
+    ///there's only ever a couple of these, the vertex arrays are kept between frames so they don't reallocate
+    std::vector<render_batch> batches;
+
+    render_batch& get_batch(const sf::Texture* tex)
+    {
+        for(render_batch& batch : batches)
+        {
+            if(batch.tex == tex)
+                return batch;
+        }
+
+        batches.emplace_back();
+        batches.back().tex = tex;
+
+        return batches.back();
+    }
+
+    void clear()
+    {
+        for(render_batch& batch : batches)
+        {
+            batch.verts.clear();
+        }
+    }
+
+    void add_quad(const sf::Texture* tex, const vec2f corners[4], sf::Color col, const vec2f uvs[4] = nullptr)
+    {
+        append_quad(get_batch(tex).verts, corners, col, uvs);
+    }
+
+    void add_rect(vec2f pos, vec2f dim, vec2f origin, float angle, sf::Color col)
+    {
+        append_rect(get_batch(nullptr).verts, pos, dim, origin, angle, col);
+    }
+
+    ///centred on pos, untransformed
+    void add_sprite(const sf::Texture& tex, vec2f pos, sf::Color col)
+    {
+        vec2f dim = {tex.getSize().x, tex.getSize().y};
+
+        vec2f tl = pos - dim/2.f;
+
+        vec2f corners[4] = {tl, tl + (vec2f){dim.x(), 0}, tl + dim, tl + (vec2f){0, dim.y()}};
+        vec2f uvs[4] = {{0, 0}, {dim.x(), 0}, dim, {0, dim.y()}};
+
+        add_quad(&tex, corners, col, uvs);
+    }
+
+    ///30 points, same as sf::CircleShape's default
+    void add_circle(vec2f pos, float rad, sf::Color col, int points = 30)
+    {
+        sf::VertexArray& verts = get_batch(nullptr).verts;
+
+        for(int i=0; i<points; i++)
+        {
+            float a1 = (i / (float)points) * 2 * M_PI;
+            float a2 = ((i + 1) / (float)points) * 2 * M_PI;
+
+            verts.append(sf::Vertex({pos.x(), pos.y()}, col));
+            verts.append(sf::Vertex({pos.x() + cosf(a1) * rad, pos.y() + sinf(a1) * rad}, col));
+            verts.append(sf::Vertex({pos.x() + cosf(a2) * rad, pos.y() + sinf(a2) * rad}, col));
+        }
+    }
+
+    ///one layer per non empty batch. The snapshot gets its own copy, as we're about to start filling these again
+    void flush(render_snapshot& snap)
+    {
+        for(render_batch& batch : batches)
+        {
+            if(batch.verts.getVertexCount() == 0)
+                continue;
+
+            snap.add(std::make_shared<sf::VertexArray>(batch.verts), batch.tex);
+        }
+
+        clear();
+    }
+};
+
+#endif // BATCH_RENDERER_HPP_INCLUDED
@@ -0,0 +1,278 @@
+#ifndef BOTS_HPP_INCLUDED
+#define BOTS_HPP_INCLUDED
+
+#include <vector>
+#include <string>
+#include <memory>
+
+///scripted players for load testing. Each bot drives a real player_character through the same
+///functions the keyboard/mouse controls use, and connects to the gameserver as its own player
+
+///own rng so a bot with the same seed always makes the same choices
+struct bot_rng
+{
+    uint32_t state = 1;
+
+    bot_rng(uint32_t seed) : state(seed * 2654435761u + 1) {}
+
+    uint32_t next()
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+
+        return state;
+    }
+
+    ///0 -> 1
+    float get()
+    {
+        return (next() & 0xFFFFFF) / (float)0xFFFFFF;
+    }
+
+    float get(float lo, float hi)
+    {
+        return lo + get() * (hi - lo);
+    }
+};
+
+struct bot_controller
+{
+    bot_rng rng;
+
+    float think_time = 0.f;
+    float think_time_max = 0.5f;
+
+    vec2f move_dir = {0,0};
+    vec2f aim_offset = {0,0};
+
+    bool wants_jump = false;
+    bool wants_jetpack = false;
+
+    float fire_cooldown = 0.f;
+    float fire_time = 0.2f;
+
+    float grapple_time = 0.f;
+
+    bot_controller(uint32_t seed) : rng(seed) {}
+
+    void think(player_character* player)
+    {
+        move_dir = {0,0};
+
+        float r = rng.get();
+
+        if(r < 0.4f)
+            move_dir.x() = -1;
+        else if(r < 0.8f)
+            move_dir.x() = 1;
+
+        wants_jump = rng.get() < 0.3f;
+        wants_jetpack = rng.get() < 0.2f;
+
+        aim_offset = {rng.get(-300.f, 300.f), rng.get(-300.f, 300.f)};
+
+        think_time_max = rng.get(0.2f, 1.f);
+
+        if(!player->hooking && rng.get() < 0.15f)
+        {
+            grapple_time = rng.get(0.3f, 1.5f);
+        }
+    }
+
+    void tick(float dt_s, state& st, player_character* player)
+    {
+        think_time += dt_s;
+
+        if(think_time >= think_time_max)
+        {
+            think(player);
+
+            think_time = 0.f;
+        }
+
+        vec2f target = player->pos + aim_offset;
+
+        ///same as the human controls in main
+        player->set_movement(move_dir * 1000.f);
+
+        if(wants_jump)
+        {
+            player->jump();
+            wants_jump = false;
+        }
+
+        player->has_friction = !wants_jetpack;
+
+        if(wants_jetpack)
+            player->should_jetpack = true;
+
+        fire_cooldown += dt_s;
+
+        if(fire_cooldown >= fire_time)
+        {
+            player->fire(target, st);
+
+            fire_cooldown = 0.f;
+        }
+
+        if(grapple_time > 0)
+        {
+            if(!player->hooking)
+                player->fire_grapple(target, st);
+
+            grapple_time -= dt_s;
+
+            if(grapple_time <= 0)
+                player->unhook();
+        }
+    }
+};
+
+///a whole client worth of state, minus the window
+///the map is shared between all bots, everything else is per bot
+struct bot_instance
+{
+    renderable_manager renderable_manage;
+    character_manager character_manage;
+    projectile_manager projectile_manage;
+    particle_system particles;
+
+    camera cam;
+
+    network_state net_state;
+
+    state st;
+
+    bot_controller controller;
+
+    player_character* player = nullptr;
+
+    bot_instance(sf::RenderWindow& dummy_win, physics_barrier_manager& physics_barrier_manage, game_world_manager& game_world_manage, uint32_t seed, const std::string& address) :
+        cam(dummy_win),
+        st(character_manage, physics_barrier_manage, game_world_manage, renderable_manage, projectile_manage, particles, cam, net_state),
+        controller(seed)
+    {
+        net_state.server_address = address;
+
+        character_manage.system_network_id = 0;
+        renderable_manage.system_network_id = 3;
+        projectile_manage.system_network_id = 4;
+
+        player = dynamic_cast<player_character*>(character_manage.make_new<player_character>(-2, net_state));
+
+        player->spawn(game_world_manage);
+        player->init_collision_pos(player->pos);
+    }
+
+    void tick(float dt_s)
+    {
+        st.dt_s = dt_s;
+
+        controller.tick(dt_s, st, player);
+
+        character_manage.tick(dt_s, st);
+        projectile_manage.tick(dt_s, st);
+
+        net_state.tick_cleanup();
+        net_state.tick_join_game(dt_s);
+        net_state.tick();
+
+        projectile_manage.check_collisions(st, character_manage);
+        projectile_manage.apply_area_damage(st, character_manage);
+        st.physics_barrier_manage.check_collisions(st, projectile_manage);
+
+        ///nobody's looking, but the pool needs emptying
+        particles.tick(dt_s);
+
+        projectile_manage.tick_all_networking<projectile_manager, projectile>(net_state);
+        character_manage.tick_all_networking<character_manager, character>(net_state);
+
+        net_state.flush_sends();
+
+        projectile_manage.cleanup(st);
+    }
+};
+
+///runs num_bots headless clients against the gameserver at address until killed
+///prints simulation cost once per second
+int run_bots(int num_bots, const std::string& address, const std::string& map_file, float tick_rate)
+{
+    ///never opened, the camera just wants something to hold on to
+    sf::RenderWindow dummy_win;
+
+    renderable_manager map_renderable_manage;
+    physics_barrier_manager physics_barrier_manage;
+    game_world_manager game_world_manage;
+
+    physics_barrier_manage.system_network_id = 1;
+    game_world_manage.system_network_id = 2;
+
+    load(map_file, physics_barrier_manage, game_world_manage, map_renderable_manage);
+
+    ///each bot holds references into its own state, so they can't move around in the vector
+    std::vector<std::unique_ptr<bot_instance>> bots;
+
+    for(int i=0; i<num_bots; i++)
+    {
+        bots.emplace_back(new bot_instance(dummy_win, physics_barrier_manage, game_world_manage, i + 1, address));
+    }
+
+    printf("Running %i bots against %s\n", num_bots, address.c_str());
+
+    sf::Clock clk;
+    sf::Clock report_clk;
+
+    double sim_time_us = 0;
+    int ticks = 0;
+
+    frame_scheduler scheduler;
+    int tick_id = scheduler.add_rate(tick_rate);
+
+    while(1)
+    {
+        scheduler.wait();
+
+        if(!scheduler.due(tick_id))
+            continue;
+
+        float dt_s = (clk.restart().asMicroseconds() / 1000.) / 1000.f;
+
+        if(dt_s > 1/33.f)
+        {
+            dt_s = 1/33.f;
+        }
+
+        sf::Clock sim_clk;
+
+        for(auto& bot : bots)
+        {
+            bot->tick(dt_s);
+        }
+
+        sim_time_us += sim_clk.getElapsedTime().asMicroseconds();
+        ticks++;
+
+        if(report_clk.getElapsedTime().asSeconds() >= 1.f)
+        {
+            int connected = 0;
+
+            for(auto& bot : bots)
+            {
+                if(bot->net_state.connected())
+                    connected++;
+            }
+
+            printf("%i/%i bots connected, %i ticks, avg tick %f ms\n", connected, num_bots, ticks, (sim_time_us / ticks) / 1000.);
+
+            sim_time_us = 0;
+            ticks = 0;
+
+            report_clk.restart();
+        }
+    }
+
+    return 0;
+}
+
+#endif // BOTS_HPP_INCLUDED
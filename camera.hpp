@@ -44,6 +44,17 @@ struct camera
         win.setView(view);
     }
 
+    ///world space rectangle that update_camera will show
+    void get_visible_rect(vec2f& tl, vec2f& br) const
+    {
+        auto dim = win.getSize();
+
+        vec2f half = (vec2f){dim.x, dim.y} * zoom / 2.f;
+
+        tl = pos - half;
+        br = pos + half;
+    }
+
     void set_zoom(float pzoom)
     {
         zoom = pzoom;
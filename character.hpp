@@ -2,17 +2,23 @@
 #define CHARACTER_HPP_INCLUDED
 
 //#include "state.hpp"
+#include "2d_quacku_servers/teaminfo_shared.hpp"
 
 struct projectile;
 
 ///do damage properly with pending damage in damageable
-struct character_base : virtual moveable, virtual renderable, virtual damageable_base, virtual collideable, virtual base_class, virtual network_serialisable, virtual grappling_hookable
+struct character_base : virtual moveable, virtual verlet_body, virtual renderable, virtual damageable_base, virtual collideable, virtual base_class, virtual network_serialisable, virtual grappling_hookable
 {
     character_base(int team) : collideable(team, collide::RAD)
     {
+        tex = get_texture_cache().acquire(team_info::get_texture_cache_name(team));
+
         collision_dim = {tex.getSize().x, tex.getSize().y};
     }
 
+    ///set by chunk_streamer while the map under us hasn't streamed in yet, we stay put rather than fall through it
+    bool waiting_for_map = false;
+
     virtual void tick(float dt_s, state& st) {};
 
     virtual void set_owner(int id)
@@ -20,6 +26,8 @@ struct character_base : virtual moveable, virtual renderable, virtual damageable
         network_serialisable::set_owner(id);
 
         team = id;
+
+        tex = get_texture_cache().acquire(team_info::get_texture_cache_name(team));
     }
 
     virtual bool can_collide() override
@@ -27,17 +35,29 @@ struct character_base : virtual moveable, virtual renderable, virtual damageable
         return hp > 0.f;
     }
 
-    virtual void render(sf::RenderWindow& win, vec2f pos)
+    virtual void render(batch_renderer& batch, vec2f pos)
     {
         if(!should_render)
             return;
 
-        sf::Sprite spr(tex);
-        spr.setOrigin(tex.getSize().x/2, tex.getSize().y/2);
-        spr.setPosition({pos.x(), pos.y()});
-        spr.setColor(sf::Color(255 * col.x(), 255 * col.y(),255 * col.z()));
+        batch.add_sprite(tex.get(), pos, sf::Color(255 * col.x(), 255 * col.y(),255 * col.z()));
+    }
+
+    ///sprite plus the grapple line
+    bool get_render_bounds(vec2f& tl, vec2f& br) override
+    {
+        vec2f half = (vec2f){tex.getSize().x, tex.getSize().y} / 2.f;
+
+        tl = pos - half;
+        br = pos + half;
+
+        if(hooking)
+        {
+            tl = {std::min(tl.x(), destination.x()), std::min(tl.y(), destination.y())};
+            br = {std::max(br.x(), destination.x()), std::max(br.y(), destination.y())};
+        }
 
-        win.draw(spr);
+        return true;
     }
 };
 
@@ -48,25 +68,48 @@ struct character : virtual character_base, virtual networkable_client, virtual d
 
     character() : collideable(-1, collide::RAD), character_base(-1) {}
 
+    ///the host doesn't care where we think it is, so this is just damage
     virtual byte_vector serialise_network() override
     {
         byte_vector vec;
-        vec.push_back(pos);
 
         vec.push_vector(damageable_client::serialise_network());
 
-        //vec.push_back(damageable_client)
+        return vec;
+    }
+
+    virtual void deserialise_network(net_view& fetch) override
+    {
+        vec2f fpos = get_wire_quantiser().get_pos(fetch);
+
+        damageable_client::deserialise_network(fetch);
+
+        set_network_pos(fpos);
+    }
+
+    ///older builds send where they think we are with their damage, the host ignores it
+    virtual byte_vector serialise_network_v1() override
+    {
+        byte_vector vec;
+        vec.push_back<vec2f>(pos);
+
+        vec.push_vector(damageable_client::serialise_network_v1());
 
         return vec;
     }
 
-    virtual void deserialise_network(byte_fetch& fetch) override
+    virtual void deserialise_network_v1(net_view& fetch) override
     {
         vec2f fpos = fetch.get<vec2f>();
 
-        pos = fpos;
+        damageable_client::deserialise_network_v1(fetch);
 
-        damageable_client::deserialise_network(fetch);
+        set_network_pos(fpos);
+    }
+
+    void set_network_pos(vec2f fpos)
+    {
+        pos = fpos;
 
         if(!have_pos)
         {
@@ -78,7 +121,7 @@ struct character : virtual character_base, virtual networkable_client, virtual d
         set_collision_pos(pos);
     }
 
-    void render(sf::RenderWindow& win) override
+    void render(batch_renderer& batch) override
     {
         //if(!spawned)
         //    return;
@@ -86,9 +129,9 @@ struct character : virtual character_base, virtual networkable_client, virtual d
         if(hp < 0)
             return;
 
-        renderable::render(win, pos);
+        renderable::render(batch, pos);
 
-        grappling_hookable::render(win);
+        grappling_hookable::render(batch);
     }
 };
 
@@ -122,6 +165,8 @@ struct player_character : virtual character_base, virtual networkable_host, virt
 
     bool has_friction = true;
 
+    constraint_solver solver;
+
     player_character(int team, network_state& ns) : character_base(team), collideable(team, collide::RAD), networkable_host(ns), damageable_host(ns)
     {
 
@@ -145,15 +190,18 @@ struct player_character : virtual character_base, virtual networkable_host, virt
 
         float min_dist = FLT_MAX;
 
-        for(physics_barrier* bar : physics_barrier_manage.objs)
+        vec2f tl = {std::min(pos.x(), dest.x()), std::min(pos.y(), dest.y())};
+        vec2f br = {std::max(pos.x(), dest.x()), std::max(pos.y(), dest.y())};
+
+        physics_barrier_manage.query(tl, br, [&](physics_barrier* bar)
         {
             vec2f line_point = point2line_intersection(bar->p1, bar->p2, pos, dest);
 
             if(!bar->within(line_point))
-                continue;
+                return;
 
             if(!bar->crosses(pos, dest))
-                continue;
+                return;
 
             float line_dist = (line_point - pos).length();
 
@@ -161,7 +209,7 @@ struct player_character : virtual character_base, virtual networkable_host, virt
             {
                 min_dist = line_dist;
             }
-        }
+        });
 
         //printf("pp2\n");
 
@@ -179,6 +227,31 @@ struct player_character : virtual character_base, virtual networkable_host, virt
         //printf("confirm hook\n");
     }
 
+    void fire(vec2f target, state& st)
+    {
+        vec2f to_target = target - pos;
+
+        if(to_target.length() < 0.0001f)
+            return;
+
+        host_projectile* p = dynamic_cast<host_projectile*>(st.projectile_manage.make_new<host_projectile>(team, st.net_state));
+        p->pos = pos;
+        p->init_collision_pos(p->pos);
+
+        vec2f inherited = ((pos - last_pos) / st.dt_s);
+
+        /*//#define VELOCITY_PARENT_INHERIT
+        #ifndef VELOCITY_PARENT_INHERIT
+        inherited = {0,0};
+        #endif // VELOCITY_PARENT_INHERIT*/
+
+        ///still not sure on this
+        inherited = projection(inherited, to_target.norm());
+
+        p->dir = to_target.norm() * 750.f + inherited;
+        //p->speed = 1000 + ;
+    }
+
     /*void on_collide(collideable* other)
     {
         if(dynamic_cast<projectile*>(other) != nullptr)
@@ -187,14 +260,14 @@ struct player_character : virtual character_base, virtual networkable_host, virt
         }
     }*/
 
-    void render(sf::RenderWindow& win) override
+    void render(batch_renderer& batch) override
     {
         //if(!spawned)
         //    return;
 
-        renderable::render(win, pos);
+        renderable::render(batch, pos);
 
-        grappling_hookable::render(win);
+        grappling_hookable::render(batch);
     }
 
     vec2f last_resort_physics(vec2f next_pos, physics_barrier* bar)
@@ -314,12 +387,12 @@ struct player_character : virtual character_base, virtual networkable_host, virt
         return next_pos;
     }
 
-    physics_barrier* get_closest(vec2f next_pos, physics_barrier_manager& physics_barrier_manage)
+    physics_barrier* get_closest(vec2f next_pos, const std::vector<physics_barrier*>& bars)
     {
         float min_dist = FLT_MAX;
         physics_barrier* min_bar = nullptr;
 
-        for(physics_barrier* bar : physics_barrier_manage.objs)
+        for(physics_barrier* bar : bars)
         {
             vec2f dist_intersect = point2line_intersection(pos, next_pos, bar->p1, bar->p2) - pos;
 
@@ -348,9 +421,9 @@ struct player_character : virtual character_base, virtual networkable_host, virt
 
     }
 
-    bool any_crosses_with_normal(vec2f p1, vec2f next_pos, physics_barrier_manager& physics_barrier_manage)
+    bool any_crosses_with_normal(vec2f p1, vec2f next_pos, const std::vector<physics_barrier*>& bars)
     {
-        for(physics_barrier* bar : physics_barrier_manage.objs)
+        for(physics_barrier* bar : bars)
         {
             if(crosses_with_normal(p1, next_pos, bar))
                 return true;
@@ -359,9 +432,9 @@ struct player_character : virtual character_base, virtual networkable_host, virt
         return false;
     }
 
-    bool full_test(vec2f pos, vec2f next_pos, vec2f accum, physics_barrier_manager& physics_barrier_manage)
+    bool full_test(vec2f pos, vec2f next_pos, vec2f accum, const std::vector<physics_barrier*>& bars)
     {
-        return !any_crosses_with_normal(next_pos, next_pos + accum, physics_barrier_manage) && !any_crosses_with_normal(pos, pos + accum, physics_barrier_manage) && !any_crosses_with_normal(pos + accum, next_pos + accum, physics_barrier_manage);
+        return !any_crosses_with_normal(next_pos, next_pos + accum, bars) && !any_crosses_with_normal(pos, pos + accum, bars) && !any_crosses_with_normal(pos + accum, next_pos + accum, bars);
     }
 
     #if 1
@@ -376,9 +449,10 @@ struct player_character : virtual character_base, virtual networkable_host, virt
     ///If we have double collisions, we can probably use the normal of my current body i'm intersecting with/near and then
     ///use that to define the appropriate normal of the next body (ie we can check if we hit underneath)
     ///this should mean that given consistently defined normals (ie dont randomly flip adjacent), we should be fine
-    vec2f adjust_next_pos_for_physics(vec2f next_pos, physics_barrier_manager& physics_barrier_manage)
+    ///bars is the set of barriers near our movement this tick, see constraint_solver::gather
+    vec2f adjust_next_pos_for_physics(vec2f next_pos, const std::vector<physics_barrier*>& bars)
     {
-        physics_barrier* min_bar = get_closest(next_pos, physics_barrier_manage);
+        physics_barrier* min_bar = get_closest(next_pos, bars);
 
         if(side_time > side_time_max)
             has_default = false;
@@ -400,7 +474,7 @@ struct player_character : virtual character_base, virtual networkable_host, virt
 
         stuck_to_surface = false;
 
-        for(physics_barrier* bar : physics_barrier_manage.objs)
+        for(physics_barrier* bar : bars)
         {
             if(crosses_with_normal(pos, next_pos, bar))
             {
@@ -424,7 +498,7 @@ struct player_character : virtual character_base, virtual networkable_host, virt
 
         accum = {0,0};
 
-        for(physics_barrier* bar : physics_barrier_manage.objs)
+        for(physics_barrier* bar : bars)
         {
             if(!bar->crosses(pos, original_next))
                 continue;
@@ -435,13 +509,13 @@ struct player_character : virtual character_base, virtual networkable_host, virt
 
             float dir = 0.f;
 
-            if(!any_crosses_with_normal(next_pos, next_pos - to_line.norm() * 5, physics_barrier_manage))
+            if(!any_crosses_with_normal(next_pos, next_pos - to_line.norm() * 5, bars))
             {
                 dir = -1;
             }
             else
             {
-                if(!any_crosses_with_normal(next_pos, next_pos + to_line.norm() * 5, physics_barrier_manage))
+                if(!any_crosses_with_normal(next_pos, next_pos + to_line.norm() * 5, bars))
                 {
                     dir = 1;
                 }
@@ -460,7 +534,7 @@ struct player_character : virtual character_base, virtual networkable_host, virt
         }
 
 
-        if(any_crosses_with_normal(pos, next_pos, physics_barrier_manage))
+        if(any_crosses_with_normal(pos, next_pos, bars))
         {
             //printf("clip\n");
         }
@@ -472,7 +546,7 @@ struct player_character : virtual character_base, virtual networkable_host, virt
 
         //if(!physics_barrier_manage.any_crosses(pos, next_pos))
         {
-            if(full_test(pos, next_pos, accum, physics_barrier_manage))
+            if(full_test(pos, next_pos, accum, bars))
             {
                 pos += accum;
                 next_pos += accum;
@@ -481,7 +555,7 @@ struct player_character : virtual character_base, virtual networkable_host, virt
             {
                 failure_state = true;
 
-                if(full_test(pos, next_pos, -accum, physics_barrier_manage))
+                if(full_test(pos, next_pos, -accum, bars))
                 {
                     pos += -accum;
                     next_pos += -accum;
@@ -497,7 +571,7 @@ struct player_character : virtual character_base, virtual networkable_host, virt
             }
         }
 
-        if(any_crosses_with_normal(pos, next_pos, physics_barrier_manage))
+        if(any_crosses_with_normal(pos, next_pos, bars))
         {
             next_pos = pos;
         }
@@ -521,9 +595,9 @@ struct player_character : virtual character_base, virtual networkable_host, virt
 
     vec2f force_enforce_no_clipping(vec2f next_pos, physics_barrier_manager& physics_barrier_manage)
     {
-        for(physics_barrier* bar : physics_barrier_manage.objs)
+        for(physics_barrier& bar : physics_barrier_manage.segments)
         {
-            if(bar->crosses(pos, next_pos))
+            if(bar.crosses(pos, next_pos))
             {
                 //next_pos = last_resort_physics(next_pos, bar);
 
@@ -549,6 +623,36 @@ struct player_character : virtual character_base, virtual networkable_host, virt
         spawn_timer = 0;
     }
 
+    ///everything that carries over from one tick to the next apart from where we are
+    ///recordings start from this so a replay starts from exactly the same place, see input_recorder
+    void reset_simulation_state()
+    {
+        reset_hp();
+        pending_network_damage = 0.f;
+
+        unhook();
+
+        should_jetpack = false;
+        flight_time_left = flight_time_max;
+
+        player_acceleration = {0,0};
+        acceleration = {0,0};
+        impulse = {0,0};
+
+        stuck_to_surface = false;
+        can_jump = false;
+        jump_dir = {0,0};
+        jump_cooldown_cur = 0.f;
+        jump_stick_cooldown_cur = 0.f;
+
+        last_dt = 1.f;
+        has_friction = true;
+
+        solver = constraint_solver();
+
+        init_collision_pos(pos);
+    }
+
     void tick_spawn(float dt, game_world_manager& game_world_manage)
     {
         if(dead())
@@ -564,8 +668,13 @@ struct player_character : virtual character_base, virtual networkable_host, virt
         }
     }
 
-    void tick(float dt, state& st) override
+    ///everything that feeds into integration. The manager integrates every body at once
+    ///and hands us back integrated_pos in tick
+    void integrate_begin(float dt, state& st, verlet_batch& batch) override
     {
+        if(waiting_for_map)
+            return;
+
         grappling_hookable::update_current_pos(pos);
 
         //stuck_to_surface = false;
@@ -620,7 +729,25 @@ struct player_character : virtual character_base, virtual networkable_host, virt
 
         //vec2f next_pos = pos + (pos - last_pos) * dt_f * friction + acceleration * ((dt + last_dt)/2.f) * dt + impulse;
         ///not sure if we need to factor in (dt + last_dt)/2 into impulse?
-        vec2f next_pos = pos + (pos - last_pos) * dt_f * friction + acceleration * acceleration_mult * ((dt + last_dt)/2.f) * dt * FORCE_MULTIPLIER + (impulse * dt) * FORCE_MULTIPLIER;
+        batch_id = batch.add(pos, last_pos, acceleration * acceleration_mult * FORCE_MULTIPLIER, impulse * FORCE_MULTIPLIER, friction, dt_f, ((dt + last_dt)/2.f) * dt);
+    }
+
+    void tick(float dt, state& st) override
+    {
+        if(waiting_for_map)
+        {
+            player_acceleration = {0,0};
+            acceleration = {0,0};
+            impulse = {0,0};
+
+            last_pos = pos;
+
+            set_collision_pos(pos);
+
+            return;
+        }
+
+        vec2f next_pos = integrated_pos;
 
         float max_speed = 0.85f * FORCE_MULTIPLIER;
 
@@ -668,21 +795,22 @@ struct player_character : virtual character_base, virtual networkable_host, virt
         }
 
         ///RESOLVE PHYSICS CONSTRAINTS
-        ///if we ever need any other physics constraints of any description whatsoever
-        ///create a proper constraint system
+        ///all constraints go through the solver, which only scans the map once per tick
+
+        solver.begin_tick();
 
         if(hooking)
         {
-            float approx_speed = (next_pos - pos).length();
-
-            vec2f old_next = next_pos;
-
-            next_pos = grappling_hookable::apply_constraint(next_pos, dt);
+            solver.add_distance(destination, cur_hook_dist);
         }
 
+        solver.gather(pos, next_pos, st.physics_barrier_manage);
+
         //vec2f next_pos = next_pos_player_only + acceleration * dt * dt + impulse;
 
-        next_pos = adjust_next_pos_for_physics(next_pos, st.physics_barrier_manage);
+        next_pos = adjust_next_pos_for_physics(next_pos, solver.nearby);
+
+        next_pos = solver.solve(pos, next_pos);
 
         //next_pos = force_enforce_no_clipping(next_pos, physics_barrier_manage);
         //next_pos = force_enforce_no_clipping(next_pos, st.physics_barrier_manage);
@@ -756,24 +884,36 @@ struct player_character : virtual character_base, virtual networkable_host, virt
         pos = fetch.get<vec2f>();
     }
 
-    virtual byte_vector serialise_network() override
+    virtual void serialise_fields(delta_fields& out) override
     {
-        byte_vector vec;
+        get_wire_quantiser().push_pos(out.vec, pos);
+        out.end_field();
+
+        damageable_host::serialise_fields(out);
+    }
+
+    ///from our slaves, which only send damage
+    virtual void deserialise_network(net_view& fetch) override
+    {
+        damageable_host::deserialise_network(fetch);
+    }
 
+    virtual byte_vector serialise_network_v1() override
+    {
+        byte_vector vec;
         vec.push_back<vec2f>(pos);
 
-        vec.push_vector(damageable_host::serialise_network());
+        vec.push_vector(damageable_host::serialise_network_v1());
 
         return vec;
     }
 
-    virtual void deserialise_network(byte_fetch& fetch) override
+    ///an older build's slave, which sends its idea of our pos before the damage
+    virtual void deserialise_network_v1(net_view& fetch) override
     {
         vec2f fpos = fetch.get<vec2f>();
 
-        //pos = fpos;
-
-        damageable_host::deserialise_network(fetch);
+        damageable_host::deserialise_network_v1(fetch);
     }
 };
 
@@ -795,10 +935,12 @@ struct player_character : virtual character_base, virtual networkable_host, virt
     }
 };*/
 
-struct character_manager : virtual renderable_manager_base<character_base>, virtual collideable_manager_base<character_base>, virtual network_manager_base<character_base>
+struct character_manager : virtual renderable_manager_base<character_base>, virtual collideable_manager_base<character_base>, virtual network_manager_base<character_base>, virtual integrateable_manager_base<character_base>
 {
     void tick(float dt, state& st)
     {
+        integrate_all(dt, st);
+
         for(character_base* c : objs)
         {
             c->tick(dt, st);
@@ -0,0 +1,589 @@
+#ifndef CHUNK_STREAMER_HPP_INCLUDED
+#define CHUNK_STREAMER_HPP_INCLUDED
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <unordered_map>
+
+///keeps only the chunks of the map near the camera and characters resident in physics_barrier_manager
+///the mapfile stays memory mapped, a worker thread turns chunks into barriers (which is where the disk reads happen)
+///and the main thread takes a few finished chunks per tick
+///
+///a chunk that comes in is appended to physics_barrier_manager's array with prev/next remapped, or -1 if the
+///neighbour isn't here, and gets a grid of its own built by the worker (physics_barrier_manager::blocks).
+///A chunk going away is cut out of the array and everything after it shuffled down. Nothing else is rebuilt
+///
+///only the small sections are checked on open, each chunk is checked against CHUNK_CHECKSUMS as it's read
+///
+///spawn positions are tiny and always resident. A character standing in a chunk that isn't resident yet
+///(usually because it's just spawned there) is held in place until it is, see character_base::waiting_for_map
+///editing a streamed map isn't supported, load it fully to edit it
+struct chunk_streamer
+{
+    enum chunk_state : uint8_t
+    {
+        UNLOADED,
+        REQUESTED,
+        RESIDENT,
+    };
+
+    ///built from the mapping by the worker
+    struct chunk_load
+    {
+        int chunk_id = -1;
+        std::vector<physics_barrier> bars;
+        ///local to the chunk, ids are offsets from its first segment
+        segment_grid grid;
+    };
+
+    struct chunk
+    {
+        map_chunk_entry entry;
+
+        chunk_state state = UNLOADED;
+
+        ///where our segments are in physics_barrier_manager while we're resident
+        int32_t first = -1;
+        int32_t count = 0;
+
+        segment_grid grid;
+    };
+
+    bool active = false;
+
+    ///chunks within this many chunks of something interesting get loaded
+    int load_radius = 1;
+    ///and get dropped once they're further than this
+    int unload_radius = 2;
+
+    ///bounds the hitch from loading in a lot at once
+    int max_integrations_per_tick = 4;
+
+    ///load on the main thread as soon as a chunk's wanted, see make_synchronous
+    bool synchronous = false;
+
+    mapped_file file;
+    map_sections sections;
+
+    float chunk_size = MAP_CHUNK_SIZE;
+
+    std::vector<chunk> chunks;
+    std::unordered_map<uint64_t, int> chunk_lookup;
+
+    ///segment id in the file -> index in physics_barrier_manager, or -1
+    std::vector<int32_t> local_id;
+
+    int num_resident_chunks = 0;
+    int num_resident_segments = 0;
+
+    std::thread worker;
+    std::mutex lock;
+    std::condition_variable wake;
+    std::deque<int> requests;
+    std::vector<chunk_load> finished;
+    bool quit = false;
+
+    uint64_t chunk_key(int cx, int cy)
+    {
+        return ((uint64_t)(uint32_t)cx << 32) | (uint32_t)cy;
+    }
+
+    ///falls back to loading the whole map if it hasn't got any chunks
+    bool open(const std::string& fname, physics_barrier_manager& physics_barrier_manage, game_world_manager& game_world_manage, renderable_manager& renderable_manage)
+    {
+        close(physics_barrier_manage);
+
+        synchronous = false;
+
+        if(!file.open(fname) || !sections.parse(file.data, file.size) || sections.size[map_section::CHUNK_INFO] != sizeof(map_chunk_info))
+        {
+            printf("No chunks in %s, loading it all\n", fname.c_str());
+
+            file.close();
+
+            load(fname, physics_barrier_manage, game_world_manage, renderable_manage);
+
+            return false;
+        }
+
+        map_chunk_info info;
+        memcpy(&info, sections.data[map_section::CHUNK_INFO], sizeof(map_chunk_info));
+
+        int num_segments = sections.size[map_section::SEGMENTS] / (sizeof(float) * 4);
+
+        ///segments and connectivity are left to be checked a chunk at a time
+        if(!sections.verify(map_section::CHUNK_INFO) || !sections.verify(map_section::CHUNKS) ||
+           !sections.verify(map_section::SPAWNS) || !sections.verify(map_section::CHUNK_CHECKSUMS) ||
+           sections.size[map_section::CHUNKS] != info.num_chunks * sizeof(map_chunk_entry) ||
+           sections.size[map_section::CONNECTIVITY] != num_segments * sizeof(int32_t) * 2 ||
+           (sections.size[map_section::CHUNK_CHECKSUMS] != 0 && sections.size[map_section::CHUNK_CHECKSUMS] != info.num_chunks * sizeof(uint32_t)))
+        {
+            printf("Bad chunk table in %s, loading it all\n", fname.c_str());
+
+            file.close();
+
+            load(fname, physics_barrier_manage, game_world_manage, renderable_manage);
+
+            return false;
+        }
+
+        chunk_size = info.chunk_size;
+
+        chunks.resize(info.num_chunks);
+
+        for(int i=0; i<info.num_chunks; i++)
+        {
+            memcpy(&chunks[i].entry, sections.data[map_section::CHUNKS] + i * sizeof(map_chunk_entry), sizeof(map_chunk_entry));
+
+            if(chunks[i].entry.first + chunks[i].entry.count > num_segments)
+            {
+                printf("Chunk %i out of bounds in %s\n", i, fname.c_str());
+
+                chunks.clear();
+                file.close();
+
+                return false;
+            }
+
+            chunk_lookup[chunk_key(chunks[i].entry.cx, chunks[i].entry.cy)] = i;
+        }
+
+        local_id.resize(num_segments, -1);
+
+        renderable_manage.erase_all();
+        physics_barrier_manage.clear();
+
+        deserialise_map_spawns(sections, game_world_manage);
+
+        quit = false;
+        worker = std::thread(&chunk_streamer::worker_func, this);
+
+        active = true;
+
+        printf("Streaming %s, %i chunks, %i segments\n", fname.c_str(), (int)chunks.size(), num_segments);
+
+        return true;
+    }
+
+    void stop_worker()
+    {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+
+            quit = true;
+            requests.clear();
+        }
+
+        wake.notify_all();
+
+        if(worker.joinable())
+            worker.join();
+    }
+
+    void close(physics_barrier_manager& physics_barrier_manage)
+    {
+        if(!active)
+            return;
+
+        stop_worker();
+
+        physics_barrier_manage.clear();
+
+        chunks.clear();
+        chunk_lookup.clear();
+        local_id.clear();
+
+        num_resident_chunks = 0;
+        num_resident_segments = 0;
+        finished.clear();
+
+        file.close();
+
+        active = false;
+    }
+
+    ~chunk_streamer()
+    {
+        stop_worker();
+    }
+
+    ///for recordings and replays. With the worker, when a chunk turns up depends on how long it took to load,
+    ///so instead everything resident is dropped and from here on chunks are loaded on the main thread the tick
+    ///they're wanted. Then what's resident only depends on where things are, and the same inputs give the same run
+    void make_synchronous(state& st)
+    {
+        if(!active || synchronous)
+            return;
+
+        stop_worker();
+
+        finished.clear();
+
+        for(int i=0; i<chunks.size(); i++)
+        {
+            if(chunks[i].state == RESIDENT)
+                unload(i, st.physics_barrier_manage);
+
+            chunks[i].state = UNLOADED;
+        }
+
+        synchronous = true;
+
+        tick(st);
+    }
+
+    ///back to loading on the worker
+    void make_asynchronous()
+    {
+        if(!active || !synchronous)
+            return;
+
+        synchronous = false;
+
+        quit = false;
+        worker = std::thread(&chunk_streamer::worker_func, this);
+    }
+
+    ///worker thread, or the main thread when synchronous
+    chunk_load read_chunk(int chunk_id)
+    {
+        const map_chunk_entry& entry = chunks[chunk_id].entry;
+
+        const float* segments = (const float*)sections.data[map_section::SEGMENTS] + entry.first * 4;
+        const int32_t* connectivity = (const int32_t*)sections.data[map_section::CONNECTIVITY] + entry.first * 2;
+
+        chunk_load load;
+        load.chunk_id = chunk_id;
+
+        ///v2 maps don't have these, but were checked in full on open
+        if(sections.size[map_section::CHUNK_CHECKSUMS] != 0)
+        {
+            uint32_t expected = ((const uint32_t*)sections.data[map_section::CHUNK_CHECKSUMS])[chunk_id];
+
+            if(map_chunk_checksum(sections.data[map_section::SEGMENTS], sections.data[map_section::CONNECTIVITY], entry) != expected)
+            {
+                printf("Chunk %i checksum mismatch, leaving it empty\n", chunk_id);
+
+                return load;
+            }
+        }
+
+        load.bars.resize(entry.count);
+
+        std::vector<vec2f> p1s;
+        std::vector<vec2f> p2s;
+
+        p1s.reserve(entry.count);
+        p2s.reserve(entry.count);
+
+        for(int i=0; i<entry.count; i++)
+        {
+            load.bars[i].set_points({segments[i*4 + 0], segments[i*4 + 1]}, {segments[i*4 + 2], segments[i*4 + 3]});
+            load.bars[i].prev = connectivity[i*2 + 0];
+            load.bars[i].next = connectivity[i*2 + 1];
+            load.bars[i].id = entry.first + i;
+
+            p1s.push_back(load.bars[i].p1);
+            p2s.push_back(load.bars[i].p2);
+        }
+
+        load.grid.build(p1s, p2s);
+
+        return load;
+    }
+
+    void worker_func()
+    {
+        while(1)
+        {
+            int chunk_id = -1;
+
+            {
+                std::unique_lock<std::mutex> guard(lock);
+
+                wake.wait(guard, [&]{return quit || requests.size() > 0;});
+
+                if(quit)
+                    return;
+
+                chunk_id = requests.front();
+                requests.pop_front();
+            }
+
+            chunk_load load = read_chunk(chunk_id);
+
+            std::lock_guard<std::mutex> guard(lock);
+
+            finished.push_back(std::move(load));
+        }
+    }
+
+    int32_t to_local(int32_t file_id)
+    {
+        return (file_id >= 0 && file_id < local_id.size()) ? local_id[file_id] : -1;
+    }
+
+    ///main thread only. Appends the chunk to the end of segments
+    void integrate(chunk_load& load, physics_barrier_manager& physics_barrier_manage)
+    {
+        chunk& c = chunks[load.chunk_id];
+
+        std::vector<physics_barrier>& segments = physics_barrier_manage.segments;
+
+        const int32_t* connectivity = (const int32_t*)sections.data[map_section::CONNECTIVITY];
+
+        c.state = RESIDENT;
+        c.first = segments.size();
+        c.count = load.bars.size();
+        c.grid = std::move(load.grid);
+
+        for(int i=0; i<c.count; i++)
+        {
+            local_id[c.entry.first + i] = c.first + i;
+        }
+
+        for(int i=0; i<c.count; i++)
+        {
+            physics_barrier bar = load.bars[i];
+
+            int32_t file_prev = bar.prev;
+            int32_t file_next = bar.next;
+
+            bar.prev = to_local(file_prev);
+            bar.next = to_local(file_next);
+
+            ///neighbours in chunks that got here first couldn't link to us
+            if(bar.prev >= 0 && bar.prev < c.first && connectivity[file_prev*2 + 1] == bar.id)
+                segments[bar.prev].next = c.first + i;
+
+            if(bar.next >= 0 && bar.next < c.first && connectivity[file_next*2 + 0] == bar.id)
+                segments[bar.next].prev = c.first + i;
+
+            segments.push_back(bar);
+
+            physics_barrier_manage.geometry.add(c.first + i, bar);
+        }
+
+        physics_barrier_manage.blocks.push_back({c.first, &c.grid});
+
+        num_resident_chunks++;
+        num_resident_segments += c.count;
+    }
+
+    ///main thread only. Cuts the chunk out of segments, and moves everything after it down
+    void unload(int chunk_id, physics_barrier_manager& physics_barrier_manage)
+    {
+        chunk& c = chunks[chunk_id];
+
+        std::vector<physics_barrier>& segments = physics_barrier_manage.segments;
+
+        int32_t first = c.first;
+        int32_t last = c.first + c.count;
+
+        auto inside = [&](int32_t id)
+        {
+            return id >= first && id < last;
+        };
+
+        ///neighbours that are staying lose their links to us
+        for(int i=first; i<last; i++)
+        {
+            physics_barrier& bar = segments[i];
+
+            if(bar.prev >= 0 && !inside(bar.prev) && segments[bar.prev].next == i)
+                segments[bar.prev].next = -1;
+
+            if(bar.next >= 0 && !inside(bar.next) && segments[bar.next].prev == i)
+                segments[bar.next].prev = -1;
+        }
+
+        for(int i=0; i<c.count; i++)
+        {
+            local_id[c.entry.first + i] = -1;
+        }
+
+        segments.erase(segments.begin() + first, segments.begin() + last);
+
+        for(physics_barrier& bar : segments)
+        {
+            if(bar.prev >= last)
+                bar.prev -= c.count;
+
+            if(bar.next >= last)
+                bar.next -= c.count;
+        }
+
+        for(chunk& other : chunks)
+        {
+            if(other.state != RESIDENT || other.first < last)
+                continue;
+
+            other.first -= c.count;
+
+            for(int i=0; i<other.count; i++)
+            {
+                local_id[other.entry.first + i] = other.first + i;
+            }
+        }
+
+        std::vector<physics_barrier_manager::segment_block>& blocks = physics_barrier_manage.blocks;
+
+        for(int i=0; i<blocks.size(); i++)
+        {
+            if(blocks[i].grid == &c.grid)
+            {
+                blocks.erase(blocks.begin() + i);
+                i--;
+                continue;
+            }
+
+            if(blocks[i].first >= last)
+                blocks[i].first -= c.count;
+        }
+
+        physics_barrier_manage.geometry.remove_range(first, c.count);
+
+        num_resident_chunks--;
+        num_resident_segments -= c.count;
+
+        c.state = UNLOADED;
+        c.first = -1;
+        c.count = 0;
+        c.grid.clear();
+    }
+
+    vec2i to_chunk(vec2f pos)
+    {
+        return {(int)floor(pos.x() / chunk_size), (int)floor(pos.y() / chunk_size)};
+    }
+
+    ///chunks that aren't in the map at all have nothing to wait for
+    bool resident_at(vec2f pos)
+    {
+        vec2i cpos = to_chunk(pos);
+
+        auto found = chunk_lookup.find(chunk_key(cpos.x(), cpos.y()));
+
+        return found == chunk_lookup.end() || chunks[found->second].state == RESIDENT;
+    }
+
+    void tick(state& st)
+    {
+        if(!active)
+        {
+            for(character_base* c : st.character_manage.objs)
+            {
+                c->waiting_for_map = false;
+            }
+
+            return;
+        }
+
+        physics_barrier_manager& physics_barrier_manage = st.physics_barrier_manage;
+
+        std::vector<vec2i> focus;
+
+        focus.push_back(to_chunk(st.cam.pos));
+
+        for(character_base* c : st.character_manage.objs)
+        {
+            focus.push_back(to_chunk(c->pos));
+        }
+
+        ///drop anything too far from everything
+        for(int i=0; i<chunks.size(); i++)
+        {
+            if(chunks[i].state != RESIDENT)
+                continue;
+
+            bool keep = false;
+
+            for(vec2i f : focus)
+            {
+                if(abs(chunks[i].entry.cx - f.x()) <= unload_radius && abs(chunks[i].entry.cy - f.y()) <= unload_radius)
+                {
+                    keep = true;
+                    break;
+                }
+            }
+
+            if(keep)
+                continue;
+
+            unload(i, physics_barrier_manage);
+        }
+
+        std::vector<int> wanted;
+
+        for(vec2i f : focus)
+        {
+            for(int y=f.y() - load_radius; y <= f.y() + load_radius; y++)
+            {
+                for(int x=f.x() - load_radius; x <= f.x() + load_radius; x++)
+                {
+                    auto found = chunk_lookup.find(chunk_key(x, y));
+
+                    if(found == chunk_lookup.end())
+                        continue;
+
+                    if(chunks[found->second].state != UNLOADED)
+                        continue;
+
+                    chunks[found->second].state = REQUESTED;
+
+                    wanted.push_back(found->second);
+                }
+            }
+        }
+
+        if(synchronous)
+        {
+            for(int id : wanted)
+            {
+                chunk_load load = read_chunk(id);
+
+                integrate(load, physics_barrier_manage);
+            }
+
+            wanted.clear();
+        }
+
+        std::vector<chunk_load> done;
+
+        {
+            std::lock_guard<std::mutex> guard(lock);
+
+            for(int id : wanted)
+            {
+                requests.push_back(id);
+            }
+
+            int num = std::min((int)finished.size(), max_integrations_per_tick);
+
+            for(int i=0; i<num; i++)
+            {
+                done.push_back(std::move(finished[i]));
+            }
+
+            finished.erase(finished.begin(), finished.begin() + num);
+        }
+
+        if(wanted.size() > 0)
+            wake.notify_one();
+
+        for(chunk_load& load : done)
+        {
+            integrate(load, physics_barrier_manage);
+        }
+
+        for(character_base* c : st.character_manage.objs)
+        {
+            c->waiting_for_map = !resident_at(c->pos);
+        }
+    }
+};
+
+#endif // CHUNK_STREAMER_HPP_INCLUDED
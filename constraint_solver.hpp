@@ -0,0 +1,272 @@
+#ifndef CONSTRAINT_SOLVER_HPP_INCLUDED
+#define CONSTRAINT_SOLVER_HPP_INCLUDED
+
+#include <vector>
+
+///position based constraints. Integration gives us a next_pos, constraints project it back into a valid position
+///everything is solved together so a grapple pulling us into a wall gets resolved by the wall, and vice versa
+
+///keeps next_pos within max_dist of anchor (ie a grappling hook)
+struct distance_constraint
+{
+    vec2f anchor;
+    float max_dist = 0.f;
+
+    ///how far we had to pull last tick, used to warm start the next solve
+    float accumulated = 0.f;
+};
+
+///keeps next_pos on the same side of a barrier as we started the tick on
+struct contact_constraint
+{
+    ///only good for the tick it was gathered in, id is what persists (see physics_barrier::id)
+    physics_barrier* bar = nullptr;
+    int32_t id = -1;
+
+    ///points towards the side we're allowed to be on
+    vec2f normal;
+
+    float accumulated = 0.f;
+};
+
+struct constraint_solver
+{
+    int iterations = 4;
+
+    ///fraction of last tick's correction we apply up front
+    float warm_start = 0.8f;
+
+    ///how far we're kept away from a barrier surface
+    ///has to be less than the character's surface stick distance or we'd never be able to jump
+    float contact_distance = 1.f;
+
+    ///extra distance around the movement to pick up barriers, has to cover the stick/jump tests in the character
+    float broadphase_margin = 10.f;
+
+    std::vector<distance_constraint> distances;
+    std::vector<contact_constraint> contacts;
+
+    ///every barrier near this tick's movement. Gathered once per tick, then everything that
+    ///wants to test against barriers uses this instead of scanning the whole map
+    std::vector<physics_barrier*> nearby;
+
+    ///constraints added this tick, become distances in gather
+    std::vector<distance_constraint> next_distances;
+
+    void add_distance(vec2f anchor, float max_dist)
+    {
+        distance_constraint con;
+        con.anchor = anchor;
+        con.max_dist = max_dist;
+
+        ///carry over warm start if its the same anchor as last tick
+        for(distance_constraint& old : distances)
+        {
+            if(old.anchor == anchor)
+            {
+                con.accumulated = old.accumulated;
+                break;
+            }
+        }
+
+        next_distances.push_back(con);
+    }
+
+    ///call once per tick before adding constraints
+    void begin_tick()
+    {
+        next_distances.clear();
+    }
+
+    ///the only full map scan per tick
+    void gather(vec2f pos, vec2f next_pos, physics_barrier_manager& physics_barrier_manage)
+    {
+        distances.swap(next_distances);
+        next_distances.clear();
+
+        vec2f tl = pos;
+        vec2f br = pos;
+
+        expand(tl, br, next_pos);
+
+        ///constraints can drag next_pos around, make sure we cover where they'd put it
+        for(distance_constraint& con : distances)
+        {
+            expand(tl, br, project_distance(next_pos, con));
+        }
+
+        tl = tl - broadphase_margin;
+        br = br + broadphase_margin;
+
+        nearby.clear();
+
+        physics_barrier_manage.query(tl, br, [&](physics_barrier* bar)
+        {
+            float minx = std::min(bar->p1.x(), bar->p2.x());
+            float maxx = std::max(bar->p1.x(), bar->p2.x());
+            float miny = std::min(bar->p1.y(), bar->p2.y());
+            float maxy = std::max(bar->p1.y(), bar->p2.y());
+
+            if(maxx < tl.x() || minx > br.x() || maxy < tl.y() || miny > br.y())
+                return;
+
+            nearby.push_back(bar);
+        });
+
+        std::vector<contact_constraint> old_contacts;
+        old_contacts.swap(contacts);
+
+        for(physics_barrier* bar : nearby)
+        {
+            contact_constraint con;
+            con.bar = bar;
+            con.id = bar->id;
+            con.normal = bar->get_normal();
+
+            if(!bar->on_normal_side(pos))
+                con.normal = -con.normal;
+
+            for(contact_constraint& old : old_contacts)
+            {
+                if(old.id == con.id)
+                {
+                    con.accumulated = old.accumulated;
+                    break;
+                }
+            }
+
+            contacts.push_back(con);
+        }
+    }
+
+    vec2f solve(vec2f pos, vec2f next_pos)
+    {
+        ///warm start, only ever apply as much as would currently be needed so we can't overshoot
+        for(distance_constraint& con : distances)
+        {
+            float extra = (next_pos - con.anchor).length() - con.max_dist;
+
+            if(extra <= 0 || con.accumulated <= 0)
+                continue;
+
+            float amount = std::min(con.accumulated * warm_start, extra);
+
+            next_pos += (con.anchor - next_pos).norm() * amount;
+        }
+
+        ///same for contacts, pushed out along the normal only as far as we'd have to be anyway
+        for(contact_constraint& con : contacts)
+        {
+            if(con.accumulated <= 0)
+                continue;
+
+            physics_barrier* bar = con.bar;
+
+            if(!bar->crosses(pos, next_pos) && !bar->within(next_pos))
+                continue;
+
+            float needed = contact_distance - dot(next_pos - bar->p1, con.normal);
+
+            if(needed <= 0)
+                continue;
+
+            float amount = std::min(con.accumulated * warm_start, needed);
+
+            next_pos += con.normal * amount;
+        }
+
+        for(distance_constraint& con : distances)
+            con.accumulated = 0.f;
+
+        for(contact_constraint& con : contacts)
+            con.accumulated = 0.f;
+
+        for(int i=0; i<iterations; i++)
+        {
+            bool any_active = false;
+
+            for(distance_constraint& con : distances)
+            {
+                vec2f projected = project_distance(next_pos, con);
+
+                float moved = (projected - next_pos).length();
+
+                if(moved > 0.0001f)
+                {
+                    con.accumulated += moved;
+                    any_active = true;
+                }
+
+                next_pos = projected;
+            }
+
+            for(contact_constraint& con : contacts)
+            {
+                float moved = 0.f;
+
+                next_pos = project_contact(pos, next_pos, con, moved);
+
+                if(moved > 0.0001f)
+                {
+                    con.accumulated += moved;
+                    any_active = true;
+                }
+            }
+
+            if(!any_active)
+                break;
+        }
+
+        ///if we still couldn't find a valid position, don't move through anything
+        for(physics_barrier* bar : nearby)
+        {
+            if(bar->crosses(pos, next_pos))
+                return pos;
+        }
+
+        return next_pos;
+    }
+
+    static void expand(vec2f& tl, vec2f& br, vec2f p)
+    {
+        tl.x() = std::min(tl.x(), p.x());
+        tl.y() = std::min(tl.y(), p.y());
+        br.x() = std::max(br.x(), p.x());
+        br.y() = std::max(br.y(), p.y());
+    }
+
+    static vec2f project_distance(vec2f next_pos, const distance_constraint& con)
+    {
+        vec2f rel = next_pos - con.anchor;
+
+        float len = rel.length();
+
+        if(len <= con.max_dist || len < 0.0001f)
+            return next_pos;
+
+        return con.anchor + (rel / len) * con.max_dist;
+    }
+
+    vec2f project_contact(vec2f pos, vec2f next_pos, const contact_constraint& con, float& moved) const
+    {
+        physics_barrier* bar = con.bar;
+
+        float dist = dot(next_pos - bar->p1, con.normal);
+
+        ///only constrain if we'd go through the barrier, or end up just about inside the surface of it
+        if(!bar->crosses(pos, next_pos) && !(bar->within(next_pos) && dist > -contact_distance))
+            return next_pos;
+
+        float needed = contact_distance - dist;
+
+        ///we're on the right side, and far enough away
+        if(needed <= 0)
+            return next_pos;
+
+        moved = needed;
+
+        return next_pos + con.normal * needed;
+    }
+};
+
+#endif // CONSTRAINT_SOLVER_HPP_INCLUDED
@@ -0,0 +1,133 @@
+#ifndef INTEGRATOR_HPP_INCLUDED
+#define INTEGRATOR_HPP_INCLUDED
+
+#include <vector>
+#include <vec/vec.hpp>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+///every body that moves by verlet integration gets written into here once per tick
+///then everything gets integrated in one go, and objects read their next position back out
+///x and y are separate arrays so we can do 4 bodies at once
+///
+///next = pos + vel * dt_f * friction + acceleration * acc_scale + impulse * dt
+///where vel is pos - last_pos, or given directly by things that know their velocity
+struct verlet_batch
+{
+    std::vector<float> pos_x, pos_y;
+    std::vector<float> vel_x, vel_y;
+    std::vector<float> acc_x, acc_y;
+    std::vector<float> imp_x, imp_y;
+    std::vector<float> fric_x, fric_y;
+
+    ///shared between x and y
+    std::vector<float> dt_f;
+    std::vector<float> acc_scale;
+
+    std::vector<float> next_x, next_y;
+
+    void clear()
+    {
+        pos_x.clear();
+        pos_y.clear();
+        vel_x.clear();
+        vel_y.clear();
+        acc_x.clear();
+        acc_y.clear();
+        imp_x.clear();
+        imp_y.clear();
+        fric_x.clear();
+        fric_y.clear();
+        dt_f.clear();
+        acc_scale.clear();
+    }
+
+    int size() const
+    {
+        return pos_x.size();
+    }
+
+    ///returns the id to read the result back with
+    int add(vec2f pos, vec2f last_pos, vec2f acceleration, vec2f impulse, vec2f friction, float pdt_f, float pacc_scale)
+    {
+        return add_velocity(pos, pos - last_pos, acceleration, impulse, friction, pdt_f, pacc_scale);
+    }
+
+    ///vel is how far to move this tick before dt_f and friction. For things with no real last_pos, faking
+    ///one as pos - vel loses precision far from the origin and gives back a different vel
+    int add_velocity(vec2f pos, vec2f vel, vec2f acceleration, vec2f impulse, vec2f friction, float pdt_f, float pacc_scale)
+    {
+        pos_x.push_back(pos.x());
+        pos_y.push_back(pos.y());
+        vel_x.push_back(vel.x());
+        vel_y.push_back(vel.y());
+        acc_x.push_back(acceleration.x());
+        acc_y.push_back(acceleration.y());
+        imp_x.push_back(impulse.x());
+        imp_y.push_back(impulse.y());
+        fric_x.push_back(friction.x());
+        fric_y.push_back(friction.y());
+        dt_f.push_back(pdt_f);
+        acc_scale.push_back(pacc_scale);
+
+        return pos_x.size() - 1;
+    }
+
+    vec2f get_next(int id) const
+    {
+        return {next_x[id], next_y[id]};
+    }
+
+    static void integrate_axis(int num, float dt,
+                               const float* pos, const float* vel, const float* acc, const float* imp, const float* fric,
+                               const float* dtf, const float* ascale, float* out)
+    {
+        int i = 0;
+
+        #ifdef __SSE2__
+        __m128 vdt = _mm_set1_ps(dt);
+
+        for(; i + 4 <= num; i += 4)
+        {
+            __m128 p = _mm_loadu_ps(pos + i);
+            __m128 v = _mm_loadu_ps(vel + i);
+            __m128 a = _mm_loadu_ps(acc + i);
+            __m128 im = _mm_loadu_ps(imp + i);
+            __m128 f = _mm_loadu_ps(fric + i);
+            __m128 df = _mm_loadu_ps(dtf + i);
+            __m128 as = _mm_loadu_ps(ascale + i);
+
+            __m128 moved = _mm_mul_ps(_mm_mul_ps(v, df), f);
+            __m128 res = _mm_add_ps(p, moved);
+
+            res = _mm_add_ps(res, _mm_mul_ps(a, as));
+            res = _mm_add_ps(res, _mm_mul_ps(im, vdt));
+
+            _mm_storeu_ps(out + i, res);
+        }
+        #endif
+
+        for(; i < num; i++)
+        {
+            out[i] = pos[i] + vel[i] * dtf[i] * fric[i] + acc[i] * ascale[i] + imp[i] * dt;
+        }
+    }
+
+    void integrate(float dt)
+    {
+        int num = size();
+
+        next_x.resize(num);
+        next_y.resize(num);
+
+        if(num == 0)
+            return;
+
+        integrate_axis(num, dt, &pos_x[0], &vel_x[0], &acc_x[0], &imp_x[0], &fric_x[0], &dt_f[0], &acc_scale[0], &next_x[0]);
+        integrate_axis(num, dt, &pos_y[0], &vel_y[0], &acc_y[0], &imp_y[0], &fric_y[0], &dt_f[0], &acc_scale[0], &next_y[0]);
+    }
+};
+
+#endif // INTEGRATOR_HPP_INCLUDED
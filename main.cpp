@@ -1,5 +1,6 @@
 #include <iostream>
 #include <fstream>
+#include <ctime>
 #include <vec/vec.hpp>
 
 #include <SFML/Graphics.hpp>
@@ -8,9 +9,14 @@
 #include "util.hpp"
 #include <net/shared.hpp>
 #include <set>
+#include <unordered_map>
+#include "spatial_index.hpp"
 #include "camera.hpp"
 #include "state.hpp"
 #include "systems.hpp"
+#include "render_thread.hpp"
+#include "particles.hpp"
+#include "profiler.hpp"
 
 #include "networking.hpp"
 
@@ -40,47 +46,36 @@ bool suppress_mouse = false;
     }
 };*/
 
-struct physics_barrier : virtual renderable, virtual collideable, virtual base_class
+///static map geometry, kept as plain data in one array in physics_barrier_manager
+///prev and next are indices into that array, or -1
+struct physics_barrier
 {
     vec2f p1;
     vec2f p2;
 
+    ///cached, see get_normal
+    vec2f normal;
+
     ///connected to p1
-    physics_barrier* next = nullptr;
+    int32_t next = -1;
     ///connected to p2
-    physics_barrier* prev = nullptr;
+    int32_t prev = -1;
 
-    physics_barrier() : collideable(-1, collide::PHYS_LINE) {}
+    ///stays the same when segments is reordered or rebuilt, unlike the index. Its index in the
+    ///file it was loaded from, or the order it was added in if it came from the editor
+    int32_t id = -1;
 
-    bool intersects(collideable* other)
+    void set_points(vec2f pp1, vec2f pp2)
     {
-        if(other->type != collide::RAD)
-            return false;
-
-        if(crosses(other->collision_pos, other->last_collision_pos))
-        {
-            return true;
-        }
+        p1 = pp1;
+        p2 = pp2;
 
-        return false;
+        normal = -perpendicular((p2 - p1).norm());
     }
 
-    virtual void render(sf::RenderWindow& win)
+    void render(sf::VertexArray& verts)
     {
-        sf::RectangleShape rect;
-
-        float width = (p2 - p1).length();
-        float height = 5.f;
-
-        rect.setSize({width, height});
-
-        float angle = (p2 - p1).angle();
-
-        rect.setRotation(r2d(angle));
-
-        rect.setPosition(p1.x(), p1.y());
-
-        win.draw(rect);
+        append_rect(verts, p1, {(p2 - p1).length(), 5.f}, {0, 0}, (p2 - p1).angle(), sf::Color::White);
     }
 
     int side(vec2f pos)
@@ -204,9 +199,9 @@ struct physics_barrier : virtual renderable, virtual collideable, virtual base_c
         return false;
     }
 
-    vec2f get_normal()
+    vec2f get_normal() const
     {
-        return -perpendicular((p2 - p1).norm());
+        return normal;
     }
 
     bool on_normal_side(vec2f pos)
@@ -259,13 +254,33 @@ struct physics_barrier : virtual renderable, virtual collideable, virtual base_c
 
     void deserialise(byte_fetch& fetch)
     {
-        p1 = fetch.get<vec2f>();
-        p2 = fetch.get<vec2f>();
+        vec2f fp1 = fetch.get<vec2f>();
+        vec2f fp2 = fetch.get<vec2f>();
+
+        set_points(fp1, fp2);
     }
 };
 
-struct physics_barrier_manager : virtual renderable_manager_base<physics_barrier>, virtual collideable_manager_base<physics_barrier>
+#include "static_geometry.hpp"
+
+///stands in for every barrier when something collides with the map, barriers have no per object collision state
+struct static_barrier_collider : collideable
+{
+    static_barrier_collider() : collideable(-1, collide::PHYS_LINE) {}
+};
+
+struct physics_barrier_manager
 {
+    int16_t system_network_id = -1;
+
+    ///all the map geometry, 36 bytes a segment
+    std::vector<physics_barrier> segments;
+
+    ///for physics_barrier::id
+    int32_t next_segment_id = 0;
+
+    static_barrier_collider collider;
+
     bool adding = false;
     vec2f adding_point;
 
@@ -286,25 +301,46 @@ struct physics_barrier_manager : virtual renderable_manager_base<physics_barrier
         {
             vec2f p2 = pos;
 
-            physics_barrier* bar = make_new<physics_barrier>();
-            bar->p1 = adding_point;
-            bar->p2 = p2;
+            physics_barrier bar;
+            bar.set_points(adding_point, p2);
+            bar.id = next_segment_id++;
 
-            adding = false;
+            if(!connectivity_built)
+                build_connectivity();
 
-            return;
+            segments.push_back(bar);
+
+            connect(segments.size() - 1);
+
+            geometry.add(segments.size() - 1, bar);
+
+            if(grid.add(segments.size() - 1))
+                rebuild_grid();
+
+            adding = false;
         }
+    }
 
-        build_connectivity();
+    void clear()
+    {
+        segments.clear();
+        grid.clear();
+        blocks.clear();
+        next_segment_id = 0;
+        geometry.invalidate_all();
+
+        p1_index.clear();
+        p2_index.clear();
+        connectivity_built = false;
     }
 
     byte_vector serialise()
     {
         byte_vector vec;
 
-        for(physics_barrier* bar : objs)
+        for(physics_barrier& bar : segments)
         {
-            vec.push_vector(bar->serialise());
+            vec.push_vector(bar.serialise());
         }
 
         return vec;
@@ -312,25 +348,147 @@ struct physics_barrier_manager : virtual renderable_manager_base<physics_barrier
 
     void deserialise(byte_fetch& fetch, int num_bytes)
     {
-        objs.clear();
+        clear();
 
-        for(int i=0; i<num_bytes / (sizeof(vec2f) * 2); i++)
+        segments.resize(num_bytes / (sizeof(vec2f) * 2));
+
+        for(physics_barrier& bar : segments)
         {
-            physics_barrier* bar = new physics_barrier;
+            bar.deserialise(fetch);
+            bar.id = next_segment_id++;
+        }
+
+        build_connectivity();
+        rebuild_grid();
+    }
 
-            bar->deserialise(fetch);
+    ///segments is 4 floats per segment, connectivity is prev/next index per segment or nullptr to work it out
+    ///the grid is expected to be filled in by the caller
+    void load_segments(const float* data, int num, const int32_t* connectivity)
+    {
+        clear();
+
+        if(num <= 0)
+            return;
 
-            objs.push_back(bar);
+        segments.resize(num);
+
+        for(int i=0; i<num; i++)
+        {
+            segments[i].set_points({data[i*4 + 0], data[i*4 + 1]}, {data[i*4 + 2], data[i*4 + 3]});
+            segments[i].id = i;
         }
 
-        build_connectivity();
+        next_segment_id = num;
+
+        if(connectivity == nullptr)
+        {
+            build_connectivity();
+            return;
+        }
+
+        for(int i=0; i<num; i++)
+        {
+            int32_t prev = connectivity[i*2 + 0];
+            int32_t next = connectivity[i*2 + 1];
+
+            segments[i].prev = (prev >= 0 && prev < num) ? prev : -1;
+            segments[i].next = (next >= 0 && next < num) ? next : -1;
+        }
+
+        ///the index is only needed when editing, build it the first time someone adds a point
+    }
+
+    ///a copy of segments in a different order, with prev/next pointing at the new indices. order[new id] = old id
+    ///leaves segments alone, anything holding indices into it (eg the geometry cache) stays good
+    std::vector<physics_barrier> reordered(const std::vector<int32_t>& order) const
+    {
+        std::vector<int32_t> new_id;
+        new_id.resize(segments.size());
+
+        for(int i=0; i<order.size(); i++)
+        {
+            new_id[order[i]] = i;
+        }
+
+        std::vector<physics_barrier> ret;
+        ret.reserve(segments.size());
+
+        for(int32_t old : order)
+        {
+            physics_barrier bar = segments[old];
+
+            bar.prev = bar.prev >= 0 ? new_id[bar.prev] : -1;
+            bar.next = bar.next >= 0 ? new_id[bar.next] : -1;
+
+            ret.push_back(bar);
+        }
+
+        return ret;
+    }
+
+    segment_grid grid;
+
+    ///a streamed map has a grid per resident chunk instead, see chunk_streamer
+    ///ids in the grid are offsets from first
+    struct segment_block
+    {
+        int32_t first = 0;
+        segment_grid* grid = nullptr;
+    };
+
+    std::vector<segment_block> blocks;
+
+    void rebuild_grid()
+    {
+        std::vector<vec2f> p1s;
+        std::vector<vec2f> p2s;
+
+        p1s.reserve(segments.size());
+        p2s.reserve(segments.size());
+
+        for(physics_barrier& bar : segments)
+        {
+            p1s.push_back(bar.p1);
+            p2s.push_back(bar.p2);
+        }
+
+        grid.build(p1s, p2s);
+    }
+
+    ///calls func(physics_barrier*) for every barrier that might overlap tl -> br
+    ///the pointer is only good until the next time segments changes
+    template<typename T>
+    void query(vec2f tl, vec2f br, T func)
+    {
+        if(blocks.size() > 0)
+        {
+            for(segment_block& block : blocks)
+            {
+                block.grid->query(tl, br, [&](uint32_t id)
+                {
+                    uint32_t global = id + block.first;
+
+                    if(global < segments.size())
+                        func(&segments[global]);
+                });
+            }
+
+            return;
+        }
+
+        grid.query(tl, br, [&](uint32_t id)
+        {
+            if(id < segments.size())
+                func(&segments[id]);
+        });
     }
 
     bool any_crosses(vec2f p1, vec2f p2)
     {
-        for(physics_barrier* bar : objs)
+        for(physics_barrier& bar : segments)
         {
-            if(bar->crosses(p1, p2))
+            if(bar.crosses(p1, p2))
                 return true;
         }
 
@@ -339,67 +497,126 @@ struct physics_barrier_manager : virtual renderable_manager_base<physics_barrier
 
     bool any_crosses_normal(vec2f p1, vec2f p2)
     {
-        for(physics_barrier* bar : objs)
+        for(physics_barrier& bar : segments)
         {
-            if(bar->crosses_normal(p1, p2))
+            if(bar.crosses_normal(p1, p2))
                 return true;
         }
 
         return false;
     }
 
-    virtual void render(sf::RenderWindow& win)
+    ///what collideable_manager_base::check_collisions does, but only against barriers near each object
+    ///everything that hits the map gets the same collider as other
+    template<typename U>
+    void check_collisions(state& st, collideable_manager_base<U>& other)
     {
-        for(renderable* r : object_manager<physics_barrier>::objs)
+        for(U* their_t : other.objs)
         {
-            r->render(win);
+            if(their_t->type != collide::RAD || !their_t->can_collide() || their_t->team == collider.team)
+                continue;
+
+            vec2f p1 = their_t->collision_pos;
+            vec2f p2 = their_t->last_collision_pos;
+
+            vec2f tl = {std::min(p1.x(), p2.x()), std::min(p1.y(), p2.y())};
+            vec2f br = {std::max(p1.x(), p2.x()), std::max(p1.y(), p2.y())};
+
+            bool hit = false;
+
+            query(tl, br, [&](physics_barrier* bar)
+            {
+                if(!hit && bar->crosses(p1, p2))
+                    hit = true;
+            });
+
+            if(hit)
+                their_t->on_collide(st, &collider);
         }
+    }
+
+    ///anything that changes segments other than add_point and the functions here needs to invalidate this
+    static_geometry_cache geometry;
+
+    batch_renderer batch;
+
+    void render(render_snapshot& snap, const cull_rect& cull)
+    {
+        geometry.render(snap, segments, cull);
+
+        if(!show_normals)
+            return;
 
-        if(show_normals)
+        ///normals are an editor thing, so they just go through the grid every frame
+        vec2f margin = {20, 20};
+
+        query(cull.tl - margin, cull.br + margin, [&](physics_barrier* bar)
         {
-            for(physics_barrier* bar : objs)
-            {
-                vec2f normal = bar->get_normal();
+            vec2f normal = bar->get_normal();
 
-                sf::RectangleShape rect;
+            vec2f center = (bar->p1 + bar->p2)/2.f;
 
-                rect.setSize({20, 2});
+            batch.add_rect(center, {20, 2}, {0, 1}, normal.angle(), sf::Color(255, 100, 100));
+        });
 
-                rect.setOrigin({0, 1});
-                rect.setFillColor(sf::Color(255, 100, 100));
+        batch.flush(snap);
+    }
 
-                vec2f center = (bar->p1 + bar->p2)/2.f;
+    ///endpoints closer than this are considered the same point
+    float connectivity_quantum = 0.01f;
 
-                rect.setPosition(center.x(), center.y());
+    ///quantised endpoint -> index of the barrier starting/ending there
+    std::unordered_map<uint64_t, int32_t> p1_index;
+    std::unordered_map<uint64_t, int32_t> p2_index;
 
-                rect.setRotation(r2d(normal.angle()));
+    uint64_t endpoint_key(vec2f pos)
+    {
+        int32_t x = (int32_t)round(pos.x() / connectivity_quantum);
+        int32_t y = (int32_t)round(pos.y() / connectivity_quantum);
 
-                win.draw(rect);
-            }
+        return ((uint64_t)(uint32_t)x << 32) | (uint32_t)y;
+    }
+
+    ///links segment id up with anything already in the index, then adds it
+    void connect(int32_t id)
+    {
+        physics_barrier& bar = segments[id];
+
+        auto found_prev = p2_index.find(endpoint_key(bar.p1));
+
+        if(found_prev != p2_index.end() && found_prev->second != id)
+        {
+            bar.prev = found_prev->second;
+            segments[found_prev->second].next = id;
+        }
+
+        auto found_next = p1_index.find(endpoint_key(bar.p2));
+
+        if(found_next != p1_index.end() && found_next->second != id)
+        {
+            bar.next = found_next->second;
+            segments[found_next->second].prev = id;
         }
+
+        p1_index[endpoint_key(bar.p1)] = id;
+        p2_index[endpoint_key(bar.p2)] = id;
     }
 
+    bool connectivity_built = false;
+
     void build_connectivity()
     {
-        for(physics_barrier* b1 : objs)
-        {
-            for(physics_barrier* b2 : objs)
-            {
-                if(b1 == b2)
-                    continue;
+        connectivity_built = true;
 
-                if(b1->p1 == b2->p2)
-                {
-                    b1->prev = b2;
-                    b2->next = b1;
-                }
+        p1_index.clear();
+        p2_index.clear();
 
-                if(b1->p2 == b2->p1)
-                {
-                    b1->next = b2;
-                    b2->prev = b1;
-                }
-            }
+        p1_index.reserve(segments.size());
+        p2_index.reserve(segments.size());
+
+        for(int i=0; i<segments.size(); i++)
+        {
+            connect(i);
         }
     }
 };
@@ -418,23 +635,24 @@ struct game_world_manager
         spawn_positions.push_back(pos);
     }
 
-    void render(sf::RenderWindow& win)
+    batch_renderer batch;
+
+    void render(render_snapshot& snap, const cull_rect& cull)
     {
         if(!should_render)
             return;
 
         float rad = 8;
 
-        sf::CircleShape circle;
-        circle.setRadius(rad);
-        circle.setOrigin(rad, rad);
-        circle.setFillColor(sf::Color(255, 128, 255));
-
         for(vec2f& pos : spawn_positions)
         {
-            circle.setPosition({pos.x(), pos.y()});
-            win.draw(circle);
+            if(!cull.overlaps(pos - rad, pos + rad))
+                continue;
+
+            batch.add_circle(pos, rad, sf::Color(255, 128, 255));
         }
+
+        batch.flush(snap);
     }
 
     void enable_rendering()
@@ -482,8 +700,34 @@ struct game_world_manager
     }
 };
 
+#include "constraint_solver.hpp"
 #include "character.hpp"
 
+byte_fetch get_file(const std::string& fname)
+{
+    // open the file:
+    std::ifstream file(fname, std::ios::binary);
+
+    file.seekg(0, std::ios::end);
+    auto file_size = file.tellg();
+    file.seekg(0, std::ios::beg);
+
+    byte_fetch ret;
+
+    if(file_size > 0)
+    {
+        ret.ptr.resize(file_size);
+        file.read((char*)&ret.ptr[0], file_size);
+    }
+
+    return ret;
+}
+
+#include "map_format.hpp"
+#include "chunk_streamer.hpp"
+#include "map_compiler.hpp"
+#include "replay.hpp"
+
 struct debug_controls
 {
     int controls_state = 0;
@@ -492,6 +736,9 @@ struct debug_controls
 
     float zoom_level = 1.f;
 
+    ///from the render thread, a frame or so behind
+    render_stats last_render_stats;
+
     void zoom(float amount)
     {
         if(amount > 0)
@@ -689,49 +936,33 @@ struct debug_controls
         ImGui::End();
     }
 
-    void player_controls(vec2f mpos, state& st, player_character* player)
+    ///only gathers input, it gets applied to the player in apply_action_input
+    void player_controls(vec2f mpos, tick_input& input)
     {
         if(suppress_mouse)
             return;
 
+        input.mouse_world = mpos;
+
         if(ONCE_MACRO(sf::Mouse::Left))
         {
-            vec2f ppos = player->pos;
-
-            vec2f to_mouse = mpos - ppos;
-
-            host_projectile* p = dynamic_cast<host_projectile*>(st.projectile_manage.make_new<host_projectile>(player->team, st.net_state));
-            p->pos = ppos;
-            p->init_collision_pos(p->pos);
-
-            vec2f inherited = ((player->pos - player->last_pos) / st.dt_s);
-
-            /*//#define VELOCITY_PARENT_INHERIT
-            #ifndef VELOCITY_PARENT_INHERIT
-            inherited = {0,0};
-            #endif // VELOCITY_PARENT_INHERIT*/
-
-            ///still not sure on this
-            inherited = projection(inherited, to_mouse.norm());
-
-            p->dir = to_mouse.norm() * 750.f + inherited;
-            //p->speed = 1000 + ;
+            input.set(input_flag::FIRE);
         }
 
         if(ONCE_MACRO(sf::Mouse::Middle))
         {
-            player->fire_grapple(mpos, st);
+            input.set(input_flag::GRAPPLE);
         }
 
         sf::Mouse mouse;
 
         if(!mouse.isButtonPressed(sf::Mouse::Middle))
         {
-            player->unhook();
+            input.set(input_flag::UNHOOK);
         }
     }
 
-    void tick(state& st, player_character* player)
+    void tick(state& st, tick_input& input)
     {
         vec2f mpos = st.cam.get_mouse_position_world();
 
@@ -756,6 +987,8 @@ struct debug_controls
             }
         }
 
+        ImGui::Text("Draw calls %i, vertices %i", last_render_stats.draw_calls, last_render_stats.vertices);
+
         if(controls_state == 0)
         {
             editor_controls(mpos, st);
@@ -763,70 +996,150 @@ struct debug_controls
 
         if(controls_state == 1)
         {
-            player_controls(mpos, st, player);
+            player_controls(mpos, input);
         }
 
         ImGui::End();
     }
 };
 
-void save(const std::string& file, physics_barrier_manager& physics_barrier_manage, game_world_manager& game_world_manage)
-{
-    byte_vector v1 = physics_barrier_manage.serialise();
-    byte_vector v2 = game_world_manage.serialise();
+#include "bots.hpp"
 
-    std::ofstream fout;
-    fout.open(file, std::ios::binary | std::ios::out);
+void latency_histogram_ui(const char* name, const latency_histogram& hist)
+{
+    ImGui::Text("%s: mean %.2fms, p50 %.2fms, p99 %.2fms, max %.2fms", name, hist.mean_ms(), hist.percentile_ms(0.5f), hist.percentile_ms(0.99f), hist.max_ms());
+}
 
-    int32_t v1_s = v1.ptr.size();
-    int32_t v2_s = v2.ptr.size();
+void latency_ui(frame_scheduler& scheduler)
+{
+    ImGui::Begin("Latency");
 
-    fout.write((char*)&v1_s, sizeof(int32_t));
-    fout.write((char*)&v2_s, sizeof(int32_t));
+    latency_histogram_ui("Input to send", scheduler.input_to_send);
+    latency_histogram_ui("Receive to render", scheduler.receive_to_render);
+    latency_histogram_ui("Wakeup lateness", scheduler.lateness);
 
-    if(v1.ptr.size() > 0)
-        fout.write((char*)&v1.ptr[0], v1.ptr.size());
+    if(ImGui::Button("Reset"))
+    {
+        scheduler.input_to_send.reset();
+        scheduler.receive_to_render.reset();
+        scheduler.lateness.reset();
+    }
 
-    if(v2.ptr.size() > 0)
-        fout.write((char*)&v2.ptr[0], v2.ptr.size());
+    ImGui::End();
 }
 
-byte_fetch get_file(const std::string& fname)
+void profiler_ui(frame_profiler& profiler, state& st, const render_stats& stats)
 {
-    // open the file:
-    std::ifstream file(fname, std::ios::binary);
+    ImGui::Begin("Profiler");
 
-    file.seekg(0, std::ios::end);
-    auto file_size = file.tellg();
-    file.seekg(0, std::ios::beg);
+    ImGui::PlotLines("Frame ms", profiler.frame_history_ms, frame_profiler::history_size, profiler.history_pos, nullptr, 0.f, 20.f, ImVec2(0, 40));
 
-    byte_fetch ret;
-
-    if(file_size > 0)
+    for(int i=0; i<frame_profiler::COUNT; i++)
     {
-        ret.ptr.resize(file_size);
-        file.read((char*)&ret.ptr[0], file_size);
+        ImGui::Text("%-16s avg %.3fms max %.3fms", frame_profiler::stage_name(i), profiler.average_ms(i), profiler.max_ms(i));
     }
 
-    return ret;
+    ImGui::Text("Characters %i, projectiles %i, particles %i", (int)st.character_manage.objs.size(), (int)st.projectile_manage.objs.size(), st.particles.num_alive);
+    ImGui::Text("Barriers %i, renderables %i", (int)st.physics_barrier_manage.segments.size(), (int)st.renderable_manage.objs.size());
+    ImGui::Text("Draw calls %i, vertices %i", stats.draw_calls, stats.vertices);
+    ImGui::Text("Net in %.1f KB/s, out %.1f KB/s in %.0f datagrams/s", profiler.bytes_in_per_s / 1024.f, profiler.bytes_out_per_s / 1024.f, profiler.datagrams_out_per_s);
+    ImGui::Text("Inbox %i waiting, %i expired", (int)st.net_state.inbox.entries.size(), st.net_state.inbox.num_expired);
+
+    ImGui::End();
 }
 
-void load(const std::string& file, physics_barrier_manager& physics_barrier_manage, game_world_manager& game_world_manage, renderable_manager& renderable_manage)
+///-bots N runs N headless bot clients instead of the game
+///-connect address sets the gameserver to join
+///-record file records player input while in player mode, -seed N fixes the seed it records with
+///-replay file runs a recording headless and checks the final state
+///-stream only keeps the bit of the map near the camera and players loaded, for big maps. Saving is disabled
+///-convert-map in out rewrites a mapfile in the current format
+///-compile-map in out merges and cleans up the segments in a mapfile and reports how many it got rid of
+///-tickrate, -netrate and -renderrate N set how many times a second the simulation ticks, the network is read and written,
+///and the world is redrawn. The window itself updates every tick. Everything sent in one network tick goes out batched
+///into as few datagrams as fit
+int main(int argc, char* argv[])
 {
-    byte_fetch fetch = get_file(file);
+    networking_init();
 
-    int32_t v1_s = fetch.get<int32_t>();
-    int32_t v2_s = fetch.get<int32_t>();
+    int num_bots = 0;
+    std::string server_address = "127.0.0.1";
+    std::string record_file;
+    std::string replay_file;
+    bool stream = false;
+    uint32_t seed = time(nullptr);
 
-    renderable_manage.erase_all();
+    float tick_rate = 240.f;
+    float net_rate = 240.f;
+    float render_rate = 144.f;
 
-    physics_barrier_manage.deserialise(fetch, v1_s);
-    game_world_manage.deserialise(fetch, v2_s);
-}
+    for(int i=1; i<argc; i++)
+    {
+        if(strcmp(argv[i], "-bots") == 0 && i + 1 < argc)
+        {
+            num_bots = atoi(argv[i+1]);
+        }
 
-int main()
-{
-    networking_init();
+        if(strcmp(argv[i], "-connect") == 0 && i + 1 < argc)
+        {
+            server_address = argv[i+1];
+        }
+
+        if(strcmp(argv[i], "-record") == 0 && i + 1 < argc)
+        {
+            record_file = argv[i+1];
+        }
+
+        if(strcmp(argv[i], "-replay") == 0 && i + 1 < argc)
+        {
+            replay_file = argv[i+1];
+        }
+
+        if(strcmp(argv[i], "-seed") == 0 && i + 1 < argc)
+        {
+            seed = atoi(argv[i+1]);
+        }
+
+        if(strcmp(argv[i], "-stream") == 0)
+        {
+            stream = true;
+        }
+
+        if(strcmp(argv[i], "-tickrate") == 0 && i + 1 < argc)
+        {
+            tick_rate = atof(argv[i+1]);
+        }
+
+        if(strcmp(argv[i], "-netrate") == 0 && i + 1 < argc)
+        {
+            net_rate = atof(argv[i+1]);
+        }
+
+        if(strcmp(argv[i], "-renderrate") == 0 && i + 1 < argc)
+        {
+            render_rate = atof(argv[i+1]);
+        }
+
+        if(strcmp(argv[i], "-convert-map") == 0 && i + 2 < argc)
+        {
+            return convert_map(argv[i+1], argv[i+2]) ? 0 : 1;
+        }
+
+        if(strcmp(argv[i], "-compile-map") == 0 && i + 2 < argc)
+        {
+            return compile_map_file(argv[i+1], argv[i+2], map_compile_settings()) ? 0 : 1;
+        }
+    }
+
+    if(replay_file.size() > 0)
+    {
+        return run_replay(replay_file);
+    }
+
+    if(num_bots > 0)
+    {
+        return run_bots(num_bots, server_address, "file.mapfile", tick_rate);
+    }
 
     sf::ContextSettings context(0, 0, 8);
 
@@ -844,13 +1157,19 @@ int main()
 
     projectile_manager projectile_manage;
 
+    particle_system particles;
+
     camera cam(win);
 
     network_state net_state;
+    net_state.server_address = server_address;
 
     debug_controls controls;
 
-    state st(character_manage, physics_barrier_manage, game_world_manage, renderable_manage, projectile_manage, cam, net_state);
+    render_thread renderer;
+    renderer.start();
+
+    state st(character_manage, physics_barrier_manage, game_world_manage, renderable_manage, projectile_manage, particles, cam, net_state);
 
     st.character_manage.system_network_id = 0;
     st.physics_barrier_manage.system_network_id = 1;
@@ -861,9 +1180,20 @@ int main()
     ///-2 team bit of a hack, objects default to -1
     player_character* test = dynamic_cast<player_character*>(character_manage.make_new<player_character>(-2, st.net_state));
 
-    load("file.mapfile", physics_barrier_manage, game_world_manage, renderable_manage);
+    chunk_streamer streamer;
+
+    bool compile_on_save = false;
+    map_compile_settings compile_settings;
+
+    if(stream)
+        streamer.open("file.mapfile", physics_barrier_manage, game_world_manage, renderable_manage);
+    else
+        load("file.mapfile", physics_barrier_manage, game_world_manage, renderable_manage);
+
     renderable_manage.add(test);
 
+    get_texture_cache().purge_unused();
+
     sf::Clock clk;
 
     sf::Keyboard key;
@@ -873,8 +1203,63 @@ int main()
 
     uint32_t frame = 0;
 
+    input_recorder recorder;
+
+    frame_scheduler scheduler;
+
+    int tick_id = scheduler.add_rate(tick_rate);
+    int net_id = scheduler.add_rate(net_rate);
+    int render_id = scheduler.add_rate(render_rate);
+
+    frame_profiler profiler;
+
+    ///set when their rate comes up, cleared by the next tick that does them
+    bool send_due = false;
+    bool publish_due = false;
+
+    ///when the oldest input that hasn't gone out on the network yet was sampled
+    int64_t unsent_input_us = -1;
+
     while(win.isOpen())
     {
+        scheduler.wait();
+
+        ///packets get read as soon as the network rate says, even if there's no tick to use them in yet
+        if(scheduler.due(net_id))
+        {
+            int64_t net_start = profiler.begin();
+
+            net_state.tick();
+
+            profiler.end(frame_profiler::NETWORK_TICK, net_start);
+
+            send_due = true;
+        }
+
+        if(scheduler.due(render_id))
+            publish_due = true;
+
+        if(!scheduler.due(tick_id))
+            continue;
+
+        int64_t input_start = profiler.begin();
+
+        ///stopped playing, the recording ends here
+        if(recorder.started && controls.controls_state != 1)
+        {
+            recorder.finish(record_file, st);
+        }
+
+        ///network damage and the like would never make it into the replay
+        if(recorder.started && net_state.connected())
+        {
+            recorder.abandon("connected to a server");
+        }
+
+        ///the recording made it load on the main thread
+        if(!recorder.started)
+            streamer.make_asynchronous();
+
         auto sfml_mpos = mouse.getPosition(win);
 
         vec2f mpos = {sfml_mpos.x, sfml_mpos.y};
@@ -923,8 +1308,6 @@ int main()
 
         vec2f move_dir;
 
-        float mult = 1000.f;
-
         if(win.hasFocus())
         {
             move_dir.x() += (int)key.isKeyPressed(sf::Keyboard::D);
@@ -957,88 +1340,228 @@ int main()
 
             if(ImGui::Button("Save"))
             {
-                save("file.mapfile", physics_barrier_manage, game_world_manage);
+                ///we only have part of the map
+                if(streamer.active)
+                {
+                    printf("Can't save a streamed map\n");
+                }
+                else
+                {
+                    if(compile_on_save)
+                        compile_map(physics_barrier_manage, compile_settings).print();
+
+                    save("file.mapfile", physics_barrier_manage, game_world_manage);
+                }
+            }
+
+            ImGui::Checkbox("Compile on save", &compile_on_save);
+
+            if(compile_on_save)
+            {
+                ImGui::DragFloat("Snap distance", &compile_settings.snap_distance, 0.01f, 0.f, 10.f);
+                ImGui::DragFloat("Max deviation", &compile_settings.max_deviation, 0.01f, 0.f, 10.f);
             }
 
             if(ImGui::Button("Load"))
             {
-                load("file.mapfile", physics_barrier_manage, game_world_manage, renderable_manage);
+                if(streamer.active)
+                    streamer.open("file.mapfile", physics_barrier_manage, game_world_manage, renderable_manage);
+                else
+                    load("file.mapfile", physics_barrier_manage, game_world_manage, renderable_manage);
 
                 renderable_manage.add(test);
+
+                ///whatever the last map's objects were holding on to
+                get_texture_cache().purge_unused();
             }
 
             ImGui::End();
         }
 
+        tick_input input;
+        input.dt_s = dt_s;
+        input.move_dir = move_dir;
+
+        profiler.end(frame_profiler::INPUT, input_start);
+
+        if(controls.controls_state == 1 && net_state.connected() && unsent_input_us == -1)
+            unsent_input_us = scheduler_now_us();
+
         if(controls.controls_state == 1)
         {
-            test->set_movement(move_dir * mult);
+            if(record_file.size() > 0 && !recorder.started && !recorder.finished)
+            {
+                recorder.begin(seed, st, test, streamer, "file.mapfile");
+            }
+
+            apply_movement_input(input, test);
 
             if(frame > 1)
+            {
+                int64_t character_start = profiler.begin();
+
                 character_manage.tick(dt_s, st);
 
+                profiler.end(frame_profiler::CHARACTER_TICK, character_start);
+
+                input.set(input_flag::CHARACTER_TICK);
+            }
+
+            int64_t projectile_start = profiler.begin();
+
             projectile_manage.tick(dt_s, st);
 
+            profiler.end(frame_profiler::PROJECTILE_TICK, projectile_start);
+
             if(ONCE_MACRO(sf::Keyboard::Space) && win.hasFocus())
             {
-                test->jump();
+                input.set(input_flag::JUMP);
             }
 
             if(key.isKeyPressed(sf::Keyboard::Space))
             {
-                test->has_friction = false;
-            }
-            else
-            {
-                test->has_friction = true;
+                input.set(input_flag::FRICTION_OFF);
             }
 
             if(mouse.isButtonPressed(sf::Mouse::Right))
             {
-                test->should_jetpack = true;
+                input.set(input_flag::JETPACK);
             }
         }
 
         test->render_ui();
 
+        controls.last_render_stats = renderer.get_stats();
+
+        latency_ui(scheduler);
+
+        profiler_ui(profiler, st, controls.last_render_stats);
+
         if(win.hasFocus())
-            controls.tick(st, test);
+            controls.tick(st, input);
 
         if(controls.controls_state == 1)
         {
+            apply_action_input(input, st, test);
+
+            recorder.record(input);
+
             cam.set_pos(test->pos);
         }
 
+        int64_t cleanup_start = profiler.begin();
+
         net_state.tick_cleanup();
         net_state.tick_join_game(dt_s);
-        net_state.tick();
+
+        profiler.end(frame_profiler::NETWORK_CLEANUP, cleanup_start);
+
+        streamer.tick(st);
+
+        int64_t collision_start = profiler.begin();
 
         projectile_manage.check_collisions(st, character_manage);
-        projectile_manage.check_collisions(st, physics_barrier_manage);
+        projectile_manage.apply_area_damage(st, character_manage);
+        physics_barrier_manage.check_collisions(st, projectile_manage);
 
-        projectile_manage.tick_all_networking<projectile_manager, projectile>(net_state);
-        character_manage.tick_all_networking<character_manager, character>(net_state);
+        profiler.end(frame_profiler::COLLISIONS, collision_start);
 
-        cam.update_camera();
+        particles.tick(dt_s);
+
+        if(send_due)
+        {
+            int64_t create_start = profiler.begin();
+
+            projectile_manage.tick_all_networking<projectile_manager, projectile>(net_state);
+            character_manage.tick_all_networking<character_manager, character>(net_state);
 
-        win.clear();
+            vec2f view_tl, view_br;
+            cam.get_visible_rect(view_tl, view_br);
+
+            net_state.send_view_region(view_tl, view_br);
+
+            net_state.flush_sends();
+
+            profiler.end(frame_profiler::NETWORK_CREATE, create_start);
+
+            send_due = false;
+
+            if(unsent_input_us != -1)
+            {
+                scheduler.input_to_send.add(scheduler_now_us() - unsent_input_us);
+
+                unsent_input_us = -1;
+            }
+        }
+
+        cam.update_camera();
 
         projectile_manage.cleanup(st);
 
-        renderable_manage.render(win);
-        physics_barrier_manage.render(win);
-        game_world_manage.render(win);
-        projectile_manage.render(win);
-        character_manage.render(win);
+        int64_t render_start = profiler.begin();
+
+        ///the window only gets a new frame at the render rate too, ticks in between just run the ui
+        bool present_due = publish_due;
+
+        if(publish_due)
+        {
+            cull_rect cull(cam);
+
+            render_snapshot& snap = renderer.back();
 
+            snap.view = cam.view;
+            snap.target_size = win.getSize();
+            snap.receive_us = net_state.unrendered_receive_us;
 
-        ImGui::Render();
-        win.display();
+            net_state.unrendered_receive_us = -1;
 
-        sf::sleep(sf::milliseconds(1));
+            renderable_manage.render(snap, cull);
+            physics_barrier_manage.render(snap, cull);
+            game_world_manage.render(snap, cull);
+            projectile_manage.render(snap, cull);
+            particles.render(snap, cull);
+            character_manage.render(snap, cull);
+
+            renderer.publish();
+
+            publish_due = false;
+        }
+
+        if(present_due)
+        {
+            win.clear();
+
+            int64_t shown_receive_us = renderer.present(win);
+
+            profiler.end(frame_profiler::RENDER, render_start);
+
+            int64_t imgui_start = profiler.begin();
+
+            ImGui::Render();
+
+            profiler.end(frame_profiler::IMGUI, imgui_start);
+
+            render_start = profiler.begin();
+
+            win.display();
+
+            if(shown_receive_us != -1)
+                scheduler.receive_to_render.add(scheduler_now_us() - shown_receive_us);
+        }
+        else
+        {
+            ///imgui still wants every frame it started finished
+            ImGui::EndFrame();
+        }
+
+        profiler.end(frame_profiler::RENDER, render_start);
+
+        profiler.end_frame(net_state.bytes_in, net_state.bytes_out, net_state.datagrams_out);
 
         frame++;
     }
 
+    recorder.finish(record_file, st);
+
     return 0;
 }
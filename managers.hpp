@@ -127,7 +127,7 @@ struct network_manager_base : virtual object_manager<T>
             if(host_object != nullptr)
             {
                 host_object->update(ns, object_manager<T>::system_network_id);
-                host_object->process_recv(ns);
+                host_object->process_recv(ns, object_manager<T>::system_network_id);
             }
 
             networkable_client* client_object = dynamic_cast<networkable_client*>(obj);
@@ -135,17 +135,18 @@ struct network_manager_base : virtual object_manager<T>
             if(client_object != nullptr)
             {
                 client_object->update(ns, object_manager<T>::system_network_id);
-                client_object->process_recv(ns);
+                client_object->process_recv(ns, object_manager<T>::system_network_id);
             }
         }
     }
 
+    ///existing entities take their messages first, whatever's left over makes new ones
     template<typename manager_type, typename real_type>
     void tick_all_networking(network_state& ns)
     {
-        tick_create_networking<manager_type, real_type>(ns);
-
         update_network_entities(ns);
+
+        tick_create_networking<manager_type, real_type>(ns);
     }
 
     virtual ~network_manager_base(){}
@@ -154,12 +155,23 @@ struct network_manager_base : virtual object_manager<T>
 template<typename T>
 struct renderable_manager_base : virtual object_manager<T>
 {
-    virtual void render(sf::RenderWindow& win)
+    batch_renderer batch;
+
+    ///a bounds test each rather than a spatial index like the map has. These all move every tick, so an index would
+    ///have to be rebuilt from everyone's bounds each frame, which is the same pass over objs as this
+    virtual void render(render_snapshot& snap, const cull_rect& cull)
     {
         for(renderable* r : object_manager<T>::objs)
         {
-            r->render(win);
+            vec2f tl, br;
+
+            if(r->get_render_bounds(tl, br) && !cull.overlaps(tl, br))
+                continue;
+
+            r->render(batch);
         }
+
+        batch.flush(snap);
     }
 };
 
@@ -200,15 +212,86 @@ struct collideable_manager_base : virtual object_manager<T>
     }
 };
 
-struct projectile_manager : virtual renderable_manager_base<projectile_base>, virtual collideable_manager_base<projectile_base>, virtual network_manager_base<projectile_base>
+template<typename T>
+struct integrateable_manager_base : virtual object_manager<T>
+{
+    verlet_batch integrator;
+
+    ///integrates every body in one batch, per object logic then runs separately and reads integrated_pos
+    void integrate_all(float dt_s, state& st)
+    {
+        integrator.clear();
+
+        for(T* obj : object_manager<T>::objs)
+        {
+            obj->batch_id = -1;
+            obj->integrate_begin(dt_s, st, integrator);
+        }
+
+        integrator.integrate(dt_s);
+
+        for(T* obj : object_manager<T>::objs)
+        {
+            if(obj->batch_id >= 0)
+                obj->integrated_pos = integrator.get_next(obj->batch_id);
+        }
+    }
+};
+
+///damage everything within rad of pos once, right now
+struct area_damage
+{
+    vec2f pos;
+    float rad = 0.f;
+    float amount = 0.f;
+    int team = -1;
+};
+
+struct projectile_manager : virtual renderable_manager_base<projectile_base>, virtual collideable_manager_base<projectile_base>, virtual network_manager_base<projectile_base>, virtual integrateable_manager_base<projectile_base>
 {
+    ///from projectiles cleaned up since the last apply_area_damage
+    std::vector<area_damage> pending_area_damage;
+
     void tick(float dt_s, state& st)
     {
+        integrate_all(dt_s, st);
+
         for(projectile_base* p : objs)
         {
             p->tick(dt_s, st);
         }
     }
+
+    void add_area_damage(const area_damage& dmg)
+    {
+        pending_area_damage.push_back(dmg);
+    }
+
+    ///one query per explosion against everything in other, same hit test as two collide::RAD collideables
+    template<typename U>
+    void apply_area_damage(state& st, collideable_manager_base<U>& other)
+    {
+        for(const area_damage& dmg : pending_area_damage)
+        {
+            for(U* their_t : other.objs)
+            {
+                if(!their_t->can_collide() || their_t->team == dmg.team)
+                    continue;
+
+                float dist = (their_t->collision_pos - dmg.pos).length();
+
+                if(dist >= dmg.rad && dist >= their_t->collision_dim.length()/2.f)
+                    continue;
+
+                damageable_base* damageable = dynamic_cast<damageable_base*>(their_t);
+
+                if(damageable != nullptr)
+                    damageable->damage(dmg.amount);
+            }
+        }
+
+        pending_area_damage.clear();
+    }
 };
 
 
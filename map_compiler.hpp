@@ -0,0 +1,285 @@
+#ifndef MAP_COMPILER_HPP_INCLUDED
+#define MAP_COMPILER_HPP_INCLUDED
+
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include "simplify.hpp"
+
+///cleans up editor output into something cheap to collide against
+///the drag tool in particular leaves thousands of tiny almost collinear segments
+///
+///1. endpoints within snap_distance of each other become the same point
+///2. zero length and duplicate segments are removed
+///3. connected runs are flipped so they go head to tail, which makes their normals agree
+///4. runs are simplified, dropping any point that's within max_deviation of the line without it (see simplify.hpp)
+
+struct map_compile_settings
+{
+    float snap_distance = 0.5f;
+    float max_deviation = 0.5f;
+};
+
+struct map_compile_report
+{
+    int segments_in = 0;
+    int zero_length = 0;
+    int duplicates = 0;
+    int flipped = 0;
+    int merged = 0;
+    int segments_out = 0;
+
+    void print()
+    {
+        printf("Map compile: %i segments -> %i (%i zero length, %i duplicates, %i merged away, %i flipped)\n", segments_in, segments_out, zero_length, duplicates, merged, flipped);
+
+        if(segments_in > 0)
+            printf("%.1f%% of segments removed\n", 100.f * (segments_in - segments_out) / segments_in);
+    }
+};
+
+inline
+map_compile_report compile_map(physics_barrier_manager& physics_barrier_manage, const map_compile_settings& settings)
+{
+    map_compile_report report;
+
+    report.segments_in = physics_barrier_manage.segments.size();
+
+    float snap = std::max(settings.snap_distance, 0.0001f);
+
+    auto point_key = [&](vec2f pos)
+    {
+        int32_t x = (int32_t)round(pos.x() / snap);
+        int32_t y = (int32_t)round(pos.y() / snap);
+
+        return ((uint64_t)(uint32_t)x << 32) | (uint32_t)y;
+    };
+
+    ///1. snap, the first point seen in a cell is the one everything else in that cell moves to
+    std::unordered_map<uint64_t, int> point_lookup;
+    std::vector<vec2f> points;
+
+    auto get_point = [&](vec2f pos)
+    {
+        uint64_t key = point_key(pos);
+
+        auto found = point_lookup.find(key);
+
+        if(found != point_lookup.end())
+            return found->second;
+
+        points.push_back(pos);
+        point_lookup[key] = points.size() - 1;
+
+        return (int)points.size() - 1;
+    };
+
+    ///segments as point ids from here on
+    std::vector<std::pair<int, int>> segments;
+    std::unordered_set<uint64_t> seen;
+
+    for(physics_barrier& bar : physics_barrier_manage.segments)
+    {
+        int i1 = get_point(bar.p1);
+        int i2 = get_point(bar.p2);
+
+        ///2.
+        if(i1 == i2)
+        {
+            report.zero_length++;
+            continue;
+        }
+
+        ///either direction counts as the same wall
+        uint64_t key = ((uint64_t)std::min(i1, i2) << 32) | (uint32_t)std::max(i1, i2);
+
+        if(seen.find(key) != seen.end())
+        {
+            report.duplicates++;
+            continue;
+        }
+
+        seen.insert(key);
+        segments.push_back({i1, i2});
+    }
+
+    std::vector<std::vector<int>> point_segments;
+    point_segments.resize(points.size());
+
+    for(int i=0; i<segments.size(); i++)
+    {
+        point_segments[segments[i].first].push_back(i);
+        point_segments[segments[i].second].push_back(i);
+    }
+
+    ///3. walk each run through points that exactly two segments share, orienting as we go
+    ///if we end up flipping most of a run, flip it back the other way instead
+    std::vector<uint8_t> visited;
+    visited.resize(segments.size());
+
+    for(int start=0; start<segments.size(); start++)
+    {
+        if(visited[start])
+            continue;
+
+        std::vector<int> component;
+        int num_flipped = 0;
+
+        std::vector<int> open;
+        open.push_back(start);
+        visited[start] = 1;
+
+        while(open.size() > 0)
+        {
+            int cur = open.back();
+            open.pop_back();
+
+            component.push_back(cur);
+
+            for(int shared : {segments[cur].first, segments[cur].second})
+            {
+                if(point_segments[shared].size() != 2)
+                    continue;
+
+                int other = point_segments[shared][0] == cur ? point_segments[shared][1] : point_segments[shared][0];
+
+                if(visited[other])
+                    continue;
+
+                visited[other] = 1;
+
+                ///cur ends here so other should start here, and the other way around
+                bool should_start_here = segments[cur].second == shared;
+                bool starts_here = segments[other].first == shared;
+
+                if(should_start_here != starts_here)
+                {
+                    std::swap(segments[other].first, segments[other].second);
+                    num_flipped++;
+                }
+
+                open.push_back(other);
+            }
+        }
+
+        if(num_flipped * 2 > component.size())
+        {
+            for(int id : component)
+            {
+                std::swap(segments[id].first, segments[id].second);
+            }
+
+            num_flipped = component.size() - num_flipped;
+        }
+
+        report.flipped += num_flipped;
+    }
+
+    ///4. pull out runs head to tail and simplify them
+    std::vector<int> next_segment;
+    std::vector<int> prev_segment;
+    next_segment.resize(segments.size(), -1);
+    prev_segment.resize(segments.size(), -1);
+
+    for(int i=0; i<segments.size(); i++)
+    {
+        int shared = segments[i].second;
+
+        if(point_segments[shared].size() != 2)
+            continue;
+
+        int other = point_segments[shared][0] == i ? point_segments[shared][1] : point_segments[shared][0];
+
+        if(segments[other].first != shared)
+            continue;
+
+        next_segment[i] = other;
+        prev_segment[other] = i;
+    }
+
+    std::vector<vec2f> out_points;
+    std::vector<float> out_segments;
+
+    std::fill(visited.begin(), visited.end(), 0);
+
+    auto emit_run = [&](int first)
+    {
+        std::vector<vec2f> run;
+        run.push_back(points[segments[first].first]);
+
+        int cur = first;
+
+        while(cur != -1 && !visited[cur])
+        {
+            visited[cur] = 1;
+
+            run.push_back(points[segments[cur].second]);
+
+            cur = next_segment[cur];
+        }
+
+        out_points.clear();
+
+        map_simplify_run(run, settings.max_deviation, out_points);
+
+        for(int i=0; i + 1<out_points.size(); i++)
+        {
+            out_segments.push_back(out_points[i].x());
+            out_segments.push_back(out_points[i].y());
+            out_segments.push_back(out_points[i+1].x());
+            out_segments.push_back(out_points[i+1].y());
+        }
+    };
+
+    ///open runs first, anything left over is a loop and gets broken at an arbitrary point
+    for(int i=0; i<segments.size(); i++)
+    {
+        if(prev_segment[i] == -1)
+            emit_run(i);
+    }
+
+    for(int i=0; i<segments.size(); i++)
+    {
+        if(!visited[i])
+            emit_run(i);
+    }
+
+    report.segments_out = out_segments.size() / 4;
+    report.merged = segments.size() - report.segments_out;
+
+    physics_barrier_manage.load_segments(out_segments.size() > 0 ? &out_segments[0] : nullptr, report.segments_out, nullptr);
+    physics_barrier_manage.rebuild_grid();
+
+    return report;
+}
+
+///loads in, compiles, and saves to out
+bool compile_map_file(const std::string& in, const std::string& out, const map_compile_settings& settings)
+{
+    renderable_manager renderable_manage;
+    physics_barrier_manager physics_barrier_manage;
+    game_world_manager game_world_manage;
+
+    mapped_file file;
+
+    if(!file.open(in))
+    {
+        printf("Could not open %s\n", in.c_str());
+        return false;
+    }
+
+    if(!deserialise_map(file.data, file.size, physics_barrier_manage, game_world_manage, renderable_manage))
+        return false;
+
+    file.close();
+
+    map_compile_report report = compile_map(physics_barrier_manage, settings);
+
+    save(out, physics_barrier_manage, game_world_manage);
+
+    report.print();
+
+    return true;
+}
+
+#endif // MAP_COMPILER_HPP_INCLUDED
@@ -0,0 +1,683 @@
+#ifndef MAP_FORMAT_HPP_INCLUDED
+#define MAP_FORMAT_HPP_INCLUDED
+
+#include <string>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <stdint.h>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+///versioned map format
+///
+///header (magic, version, number of sections, checksum of the section table)
+///section table (id, offset from start of file, size in bytes, checksum of the section)
+///sections, each 8 byte aligned
+///
+///only the header and table are checked on open, each section is checked the first time it's used (map_sections::verify)
+///so opening a big map doesn't have to read all of it. Streaming checks chunks one at a time (CHUNK_CHECKSUMS) as they load
+///v2 maps have one checksum of everything after the header instead, and are checked in full when opened
+///
+///everything is stored as flat arrays in the layout we use in memory so that a mapped file
+///can be used more or less directly
+///
+///the old format (two int32 lengths then raw vec2fs) is detected by the missing magic number and converted on load
+///
+///segments are sorted by the chunk their midpoint falls in, so each chunk is one contiguous run of segments
+///and can be streamed in on its own
+
+#define MAP_MAGIC 0x50414d51 ///QMAP
+#define MAP_VERSION 3
+
+namespace map_section
+{
+    enum map_section : uint32_t
+    {
+        SEGMENTS, ///4 floats per segment, p1 then p2
+        CONNECTIVITY, ///2 int32s per segment, index of prev and next or -1
+        SPAWNS, ///2 floats per spawn
+        GRID_INFO, ///map_grid_info
+        GRID_CELLS, ///uint32 cell_start, width * height + 1 of them
+        GRID_ITEMS, ///uint32 segment ids
+        CHUNK_INFO, ///map_chunk_info
+        CHUNKS, ///map_chunk_entry per chunk
+        CHUNK_CHECKSUMS, ///uint32 per chunk, map_chunk_checksum of its segments then its connectivity
+        COUNT
+    };
+}
+
+struct map_header
+{
+    uint32_t magic = MAP_MAGIC;
+    uint32_t version = MAP_VERSION;
+    uint32_t num_sections = 0;
+    uint32_t checksum = 0;
+};
+
+struct map_section_entry
+{
+    uint32_t id = 0;
+    uint32_t offset = 0;
+    uint32_t size = 0;
+    ///not in v2
+    uint32_t checksum = 0;
+};
+
+#define MAP_V2_SECTION_ENTRY_SIZE (sizeof(uint32_t) * 3)
+
+struct map_grid_info
+{
+    float origin_x = 0;
+    float origin_y = 0;
+    float cell_size = 0;
+    int32_t width = 0;
+    int32_t height = 0;
+    int32_t num_segments = 0;
+};
+
+#define MAP_CHUNK_SIZE 1024.f
+
+struct map_chunk_info
+{
+    float chunk_size = MAP_CHUNK_SIZE;
+    int32_t num_chunks = 0;
+};
+
+///segments first -> first + count belong to chunk cx, cy
+struct map_chunk_entry
+{
+    int32_t cx = 0;
+    int32_t cy = 0;
+    uint32_t first = 0;
+    uint32_t count = 0;
+};
+
+inline
+vec2i map_chunk_of(vec2f p1, vec2f p2, float chunk_size)
+{
+    vec2f mid = (p1 + p2) / 2.f;
+
+    return {(int)floor(mid.x() / chunk_size), (int)floor(mid.y() / chunk_size)};
+}
+
+///fnv1a, pass the last result back in as hash to carry on
+inline
+uint32_t map_checksum(const char* data, size_t len, uint32_t hash = 2166136261u)
+{
+    for(size_t i=0; i<len; i++)
+    {
+        hash ^= (uint8_t)data[i];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+///what CHUNK_CHECKSUMS holds, segments and connectivity are the start of those sections
+inline
+uint32_t map_chunk_checksum(const char* segments, const char* connectivity, const map_chunk_entry& entry)
+{
+    uint32_t hash = map_checksum(segments + (size_t)entry.first * sizeof(float) * 4, (size_t)entry.count * sizeof(float) * 4);
+
+    return map_checksum(connectivity + (size_t)entry.first * sizeof(int32_t) * 2, (size_t)entry.count * sizeof(int32_t) * 2, hash);
+}
+
+///read only memory mapped file
+struct mapped_file
+{
+    const char* data = nullptr;
+    size_t size = 0;
+
+    #ifdef _WIN32
+    HANDLE file_handle = INVALID_HANDLE_VALUE;
+    HANDLE mapping_handle = NULL;
+    #endif
+
+    bool open(const std::string& fname)
+    {
+        close();
+
+        #ifdef _WIN32
+        file_handle = CreateFileA(fname.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+
+        if(file_handle == INVALID_HANDLE_VALUE)
+            return false;
+
+        LARGE_INTEGER file_size;
+
+        if(!GetFileSizeEx(file_handle, &file_size) || file_size.QuadPart == 0)
+        {
+            close();
+            return false;
+        }
+
+        mapping_handle = CreateFileMappingA(file_handle, NULL, PAGE_READONLY, 0, 0, NULL);
+
+        if(mapping_handle == NULL)
+        {
+            close();
+            return false;
+        }
+
+        data = (const char*)MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0);
+        size = file_size.QuadPart;
+        #else
+        int fd = ::open(fname.c_str(), O_RDONLY);
+
+        if(fd < 0)
+            return false;
+
+        struct stat st;
+
+        if(fstat(fd, &st) != 0 || st.st_size == 0)
+        {
+            ::close(fd);
+            return false;
+        }
+
+        void* ptr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        ::close(fd);
+
+        if(ptr == MAP_FAILED)
+            return false;
+
+        data = (const char*)ptr;
+        size = st.st_size;
+        #endif
+
+        if(data == nullptr)
+        {
+            close();
+            return false;
+        }
+
+        return true;
+    }
+
+    void close()
+    {
+        #ifdef _WIN32
+        if(data)
+            UnmapViewOfFile(data);
+
+        if(mapping_handle != NULL)
+            CloseHandle(mapping_handle);
+
+        if(file_handle != INVALID_HANDLE_VALUE)
+            CloseHandle(file_handle);
+
+        mapping_handle = NULL;
+        file_handle = INVALID_HANDLE_VALUE;
+        #else
+        if(data)
+            munmap((void*)data, size);
+        #endif
+
+        data = nullptr;
+        size = 0;
+    }
+
+    ~mapped_file()
+    {
+        close();
+    }
+};
+
+///the live map isn't touched, it gets saved and recorded mid game
+byte_vector serialise_map(physics_barrier_manager& physics_barrier_manage, game_world_manager& game_world_manage)
+{
+    const std::vector<physics_barrier>& live = physics_barrier_manage.segments;
+
+    ///the file's sorted by chunk, from a copy
+    std::vector<int32_t> order;
+    order.resize(live.size());
+
+    for(int i=0; i<live.size(); i++)
+    {
+        order[i] = i;
+    }
+
+    std::stable_sort(order.begin(), order.end(), [&](int32_t b1, int32_t b2)
+    {
+        vec2i c1 = map_chunk_of(live[b1].p1, live[b1].p2, MAP_CHUNK_SIZE);
+        vec2i c2 = map_chunk_of(live[b2].p1, live[b2].p2, MAP_CHUNK_SIZE);
+
+        if(c1.y() != c2.y())
+            return c1.y() < c2.y();
+
+        return c1.x() < c2.x();
+    });
+
+    std::vector<physics_barrier> bars = physics_barrier_manage.reordered(order);
+
+    std::vector<vec2f> p1s;
+    std::vector<vec2f> p2s;
+
+    p1s.reserve(bars.size());
+    p2s.reserve(bars.size());
+
+    for(physics_barrier& bar : bars)
+    {
+        p1s.push_back(bar.p1);
+        p2s.push_back(bar.p2);
+    }
+
+    ///the saved grid indexes the sorted order
+    segment_grid grid;
+    grid.build(p1s, p2s);
+
+    byte_vector sections[map_section::COUNT];
+
+    for(physics_barrier& bar : bars)
+    {
+        sections[map_section::SEGMENTS].push_back<float>(bar.p1.x());
+        sections[map_section::SEGMENTS].push_back<float>(bar.p1.y());
+        sections[map_section::SEGMENTS].push_back<float>(bar.p2.x());
+        sections[map_section::SEGMENTS].push_back<float>(bar.p2.y());
+
+        sections[map_section::CONNECTIVITY].push_back<int32_t>(bar.prev);
+        sections[map_section::CONNECTIVITY].push_back<int32_t>(bar.next);
+    }
+
+    for(vec2f& pos : game_world_manage.spawn_positions)
+    {
+        sections[map_section::SPAWNS].push_back<float>(pos.x());
+        sections[map_section::SPAWNS].push_back<float>(pos.y());
+    }
+
+    map_grid_info info;
+    info.origin_x = grid.origin.x();
+    info.origin_y = grid.origin.y();
+    info.cell_size = grid.cell_size;
+    info.width = grid.width;
+    info.height = grid.height;
+    info.num_segments = grid.num_segments;
+
+    sections[map_section::GRID_INFO].push_back<map_grid_info>(info);
+
+    for(uint32_t i : grid.cell_start)
+        sections[map_section::GRID_CELLS].push_back<uint32_t>(i);
+
+    for(uint32_t i : grid.cell_items)
+        sections[map_section::GRID_ITEMS].push_back<uint32_t>(i);
+
+    map_chunk_info chunk_info;
+
+    for(int i=0; i<bars.size(); i++)
+    {
+        vec2i chunk = map_chunk_of(bars[i].p1, bars[i].p2, chunk_info.chunk_size);
+
+        map_chunk_entry entry;
+        entry.cx = chunk.x();
+        entry.cy = chunk.y();
+        entry.first = i;
+        entry.count = 1;
+
+        while(i + 1 < bars.size())
+        {
+            vec2i next = map_chunk_of(bars[i+1].p1, bars[i+1].p2, chunk_info.chunk_size);
+
+            if(next.x() != chunk.x() || next.y() != chunk.y())
+                break;
+
+            entry.count++;
+            i++;
+        }
+
+        sections[map_section::CHUNKS].push_back<map_chunk_entry>(entry);
+        sections[map_section::CHUNK_CHECKSUMS].push_back<uint32_t>(map_chunk_checksum(sections[map_section::SEGMENTS].ptr.data(), sections[map_section::CONNECTIVITY].ptr.data(), entry));
+
+        chunk_info.num_chunks++;
+    }
+
+    sections[map_section::CHUNK_INFO].push_back<map_chunk_info>(chunk_info);
+
+    map_header header;
+    header.num_sections = map_section::COUNT;
+
+    uint32_t offset = sizeof(map_header) + sizeof(map_section_entry) * map_section::COUNT;
+
+    offset = (offset + 7) & ~7u;
+
+    byte_vector table;
+
+    for(int i=0; i<map_section::COUNT; i++)
+    {
+        map_section_entry entry;
+        entry.id = i;
+        entry.offset = offset;
+        entry.size = sections[i].ptr.size();
+        entry.checksum = entry.size > 0 ? map_checksum(&sections[i].ptr[0], entry.size) : map_checksum(nullptr, 0);
+
+        table.push_back<map_section_entry>(entry);
+
+        offset += entry.size;
+        offset = (offset + 7) & ~7u;
+    }
+
+    byte_vector body;
+    body.push_vector(table);
+
+    for(int i=0; i<map_section::COUNT; i++)
+    {
+        ///body starts after the header, so alignment within the file is alignment within body + header size
+        while((body.ptr.size() + sizeof(map_header)) % 8 != 0)
+            body.push_back<uint8_t>(0);
+
+        body.push_vector(sections[i]);
+    }
+
+    header.checksum = map_checksum(&table.ptr[0], table.ptr.size());
+
+    byte_vector ret;
+    ret.push_back<map_header>(header);
+    ret.push_vector(body);
+
+    return ret;
+}
+
+///where each section lives in a v2 or v3 map
+struct map_sections
+{
+    const char* data[map_section::COUNT] = {nullptr};
+    uint32_t size[map_section::COUNT] = {0};
+
+    uint32_t checksum[map_section::COUNT] = {0};
+    ///v2 is all checked up front, so everything starts off verified
+    bool verified[map_section::COUNT] = {false};
+
+    ///just the header and table. Call verify before using a section
+    bool parse(const char* file, size_t len)
+    {
+        if(file == nullptr || len < sizeof(map_header))
+        {
+            printf("Map too small\n");
+            return false;
+        }
+
+        map_header header;
+        memcpy(&header, file, sizeof(map_header));
+
+        if(header.magic != MAP_MAGIC)
+        {
+            printf("Not a v2 map\n");
+            return false;
+        }
+
+        if(header.version != 2 && header.version != MAP_VERSION)
+        {
+            printf("Unsupported map version %i\n", header.version);
+            return false;
+        }
+
+        size_t entry_size = header.version == 2 ? MAP_V2_SECTION_ENTRY_SIZE : sizeof(map_section_entry);
+        size_t table_size = entry_size * header.num_sections;
+
+        if(len - sizeof(map_header) < table_size)
+        {
+            printf("Map section table truncated\n");
+            return false;
+        }
+
+        const char* table = file + sizeof(map_header);
+
+        uint32_t found = header.version == 2 ? map_checksum(table, len - sizeof(map_header)) : map_checksum(table, table_size);
+
+        if(found != header.checksum)
+        {
+            printf("Map checksum mismatch\n");
+            return false;
+        }
+
+        for(uint32_t i=0; i<header.num_sections; i++)
+        {
+            map_section_entry entry;
+            memcpy(&entry, table + entry_size * i, entry_size);
+
+            ///newer sections we don't know about
+            if(entry.id >= map_section::COUNT)
+                continue;
+
+            if((size_t)entry.offset + entry.size > len)
+            {
+                printf("Map section %i out of bounds\n", entry.id);
+                return false;
+            }
+
+            data[entry.id] = file + entry.offset;
+            size[entry.id] = entry.size;
+            checksum[entry.id] = entry.checksum;
+            verified[entry.id] = header.version == 2;
+        }
+
+        return true;
+    }
+
+    ///true if the section's fine to use, or isn't there (size 0). Only checks it the first time
+    bool verify(uint32_t id)
+    {
+        if(verified[id] || data[id] == nullptr)
+            return true;
+
+        if(map_checksum(data[id], size[id]) != checksum[id])
+        {
+            printf("Map section %i checksum mismatch\n", id);
+            return false;
+        }
+
+        verified[id] = true;
+
+        return true;
+    }
+};
+
+///the old format, two int32 byte counts then the segments and spawns they cover
+bool deserialise_map_legacy(byte_fetch& fetch, size_t len, physics_barrier_manager& physics_barrier_manage, game_world_manager& game_world_manage)
+{
+    int32_t v1_s = fetch.get<int32_t>();
+    int32_t v2_s = fetch.get<int32_t>();
+
+    size_t remaining = len - sizeof(int32_t) * 2;
+
+    if(v1_s < 0 || v2_s < 0 || (size_t)v1_s > remaining || (size_t)v2_s > remaining - v1_s ||
+       v1_s % (sizeof(vec2f) * 2) != 0 || v2_s % sizeof(vec2f) != 0)
+    {
+        printf("Old format map has bad lengths %i %i\n", v1_s, v2_s);
+        return false;
+    }
+
+    physics_barrier_manage.deserialise(fetch, v1_s);
+    game_world_manage.deserialise(fetch, v2_s);
+
+    return true;
+}
+
+void deserialise_map_spawns(const map_sections& sections, game_world_manager& game_world_manage)
+{
+    const float* spawns = (const float*)sections.data[map_section::SPAWNS];
+    int num_spawns = sections.size[map_section::SPAWNS] / (sizeof(float) * 2);
+
+    game_world_manage.spawn_positions.clear();
+
+    for(int i=0; i<num_spawns; i++)
+    {
+        game_world_manage.spawn_positions.push_back({spawns[i*2 + 0], spawns[i*2 + 1]});
+    }
+}
+
+///the cell ranges have to start at 0, never go backwards, and end exactly at the end of the items,
+///and every item has to be a segment we've got. Anything else and we'd read or write out of bounds
+bool map_grid_valid(const uint32_t* cells, int num_cells, const uint32_t* items, uint32_t num_items, int num_segments)
+{
+    if(cells[0] != 0 || cells[num_cells] != num_items)
+        return false;
+
+    for(int i=0; i<num_cells; i++)
+    {
+        if(cells[i] > cells[i+1])
+            return false;
+    }
+
+    for(uint32_t i=0; i<num_items; i++)
+    {
+        if(items[i] >= (uint32_t)num_segments)
+            return false;
+    }
+
+    return true;
+}
+
+bool deserialise_map(const char* data, size_t len, physics_barrier_manager& physics_barrier_manage, game_world_manager& game_world_manage, renderable_manager& renderable_manage)
+{
+    if(data == nullptr || len < sizeof(int32_t) * 2)
+    {
+        printf("Map too small\n");
+        return false;
+    }
+
+    renderable_manage.erase_all();
+
+    map_header header;
+    memcpy(&header, data, std::min(len, sizeof(map_header)));
+
+    if(header.magic != MAP_MAGIC)
+    {
+        printf("Converting old format map\n");
+
+        byte_fetch fetch;
+        fetch.ptr.assign(data, data + len);
+
+        return deserialise_map_legacy(fetch, len, physics_barrier_manage, game_world_manage);
+    }
+
+    map_sections parsed;
+
+    if(!parsed.parse(data, len))
+        return false;
+
+    if(!parsed.verify(map_section::SEGMENTS) || !parsed.verify(map_section::SPAWNS))
+        return false;
+
+    const char** sections = parsed.data;
+    uint32_t* sizes = parsed.size;
+
+    int num_segments = sizes[map_section::SEGMENTS] / (sizeof(float) * 4);
+
+    const int32_t* connectivity = nullptr;
+
+    ///the rest can be worked out again if they're broken
+    if(sizes[map_section::CONNECTIVITY] == num_segments * sizeof(int32_t) * 2 && parsed.verify(map_section::CONNECTIVITY))
+        connectivity = (const int32_t*)sections[map_section::CONNECTIVITY];
+
+    physics_barrier_manage.load_segments((const float*)sections[map_section::SEGMENTS], num_segments, connectivity);
+
+    bool has_grid = false;
+
+    if(sizes[map_section::GRID_INFO] == sizeof(map_grid_info) &&
+       parsed.verify(map_section::GRID_INFO) && parsed.verify(map_section::GRID_CELLS) && parsed.verify(map_section::GRID_ITEMS))
+    {
+        map_grid_info info;
+        memcpy(&info, sections[map_section::GRID_INFO], sizeof(map_grid_info));
+
+        ///everything's checked before the grid's trusted, segment_grid::query indexes with these directly
+        bool dim_ok = info.width > 0 && info.height > 0 && info.width <= (INT32_MAX - 1) / info.height && info.cell_size > 0;
+
+        int num_cells = dim_ok ? info.width * info.height : 0;
+
+        const uint32_t* cells = (const uint32_t*)sections[map_section::GRID_CELLS];
+        const uint32_t* items = (const uint32_t*)sections[map_section::GRID_ITEMS];
+
+        uint32_t num_items = sizes[map_section::GRID_ITEMS] / sizeof(uint32_t);
+
+        if(dim_ok && info.num_segments == num_segments && sizes[map_section::GRID_CELLS] == (uint64_t)(num_cells + 1) * sizeof(uint32_t) &&
+           map_grid_valid(cells, num_cells, items, num_items, num_segments))
+        {
+            segment_grid& grid = physics_barrier_manage.grid;
+
+            grid.clear();
+            grid.origin = {info.origin_x, info.origin_y};
+            grid.cell_size = info.cell_size;
+            grid.width = info.width;
+            grid.height = info.height;
+            grid.num_segments = info.num_segments;
+            grid.cell_start.assign(cells, cells + num_cells + 1);
+            grid.cell_items.assign(items, items + num_items);
+            grid.stamps.resize(num_segments);
+
+            has_grid = true;
+        }
+    }
+
+    if(!has_grid)
+        physics_barrier_manage.rebuild_grid();
+
+    deserialise_map_spawns(parsed, game_world_manage);
+
+    return true;
+}
+
+void save(const std::string& file, physics_barrier_manager& physics_barrier_manage, game_world_manager& game_world_manage)
+{
+    byte_vector vec = serialise_map(physics_barrier_manage, game_world_manage);
+
+    std::ofstream fout;
+    fout.open(file, std::ios::binary | std::ios::out);
+
+    if(vec.ptr.size() > 0)
+        fout.write((char*)&vec.ptr[0], vec.ptr.size());
+}
+
+void load(const std::string& file, physics_barrier_manager& physics_barrier_manage, game_world_manager& game_world_manage, renderable_manager& renderable_manage)
+{
+    mapped_file mapped;
+
+    if(!mapped.open(file))
+    {
+        printf("Could not open map %s\n", file.c_str());
+        return;
+    }
+
+    if(!deserialise_map(mapped.data, mapped.size, physics_barrier_manage, game_world_manage, renderable_manage))
+    {
+        printf("Could not load map %s\n", file.c_str());
+    }
+}
+
+///old format -> new format, or just a resave
+bool convert_map(const std::string& in, const std::string& out)
+{
+    renderable_manager renderable_manage;
+    physics_barrier_manager physics_barrier_manage;
+    game_world_manager game_world_manage;
+
+    mapped_file file;
+
+    if(!file.open(in))
+    {
+        printf("Could not open %s\n", in.c_str());
+        return false;
+    }
+
+    if(!deserialise_map(file.data, file.size, physics_barrier_manage, game_world_manage, renderable_manage))
+        return false;
+
+    save(out, physics_barrier_manage, game_world_manage);
+
+    printf("Converted %s to %s, %i segments\n", in.c_str(), out.c_str(), (int)physics_barrier_manage.segments.size());
+
+    return true;
+}
+
+#endif // MAP_FORMAT_HPP_INCLUDED
@@ -1,19 +1,29 @@
 #include "networkable_systems.hpp"
 #include "state.hpp"
 #include "managers.hpp"
+#include "particles.hpp"
+
+///visual radius, and how far the damage reaches
+///the reach is what the old explosion collideable's 20x20 collision_dim came out to
+static constexpr float explosion_rad = 10.f;
+static constexpr float explosion_reach = 14.142f;
+static constexpr float explosion_damage = 0.35f;
 
 void projectile::on_cleanup(state& st)
 {
-    auto proj = st.projectile_manage.make_new<explosion_projectile_client>();
-
-    proj->pos = pos;
-    proj->init_collision_pos(pos);
+    st.particles.explosion(pos, explosion_rad);
 }
 
 void host_projectile::on_cleanup(state& st)
 {
-    auto proj = st.projectile_manage.make_new<explosion_projectile_host>();
+    st.particles.explosion(pos, explosion_rad);
+
+    area_damage dmg;
+    dmg.pos = pos;
+    dmg.rad = explosion_reach;
+    dmg.amount = explosion_damage;
+    ///hits everyone, the person who fired it included
+    dmg.team = -3;
 
-    proj->pos = pos;
-    proj->init_collision_pos(pos);
+    st.projectile_manage.add_area_damage(dmg);
 }
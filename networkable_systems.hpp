@@ -3,6 +3,23 @@
 
 #include "networking.hpp"
 
+namespace damage_flags
+{
+    enum type : uint8_t
+    {
+        ///otherwise it's damage from a client
+        HOST_HP = 1,
+    };
+}
+
+namespace projectile_flags
+{
+    enum type : uint8_t
+    {
+        SHOULD_CLEANUP = 1,
+    };
+}
+
 struct damageable_base : virtual network_serialisable
 {
     float hp = 1.f;
@@ -39,21 +56,49 @@ struct damageable_base : virtual network_serialisable
 
     }
 
+    ///whatever the quantiser rounds off stays pending for next time
     virtual byte_vector serialise_network() override
     {
+        wire_quantiser& quant = get_wire_quantiser();
+
+        uint16_t sent = quant.quantise_damage(pending_network_damage);
+
         byte_vector vec;
-        vec.push_back<float>(pending_network_damage);
-        vec.push_back<int32_t>(0);
+        vec.push_back<uint8_t>(0);
+        vec.push_back<uint16_t>(sent);
 
-        pending_network_damage = 0.f;
+        pending_network_damage -= quant.unquantise_damage(sent);
 
         return vec;
     }
 
-    virtual void deserialise_network(byte_fetch& fetch) override
+    virtual void deserialise_network(net_view& fetch) override
+    {
+        wire_quantiser& quant = get_wire_quantiser();
+
+        uint8_t flags = fetch.get<uint8_t>();
+
+        if((flags & damage_flags::HOST_HP) == 0)
+            hp -= quant.unquantise_damage(fetch.get<uint16_t>());
+        else
+            hp = quant.unquantise_hp(fetch.get<uint8_t>());
+    }
+
+    ///exactly what serialise_network is about to take off pending, so it only counts once whoever it goes to
+    virtual byte_vector serialise_network_v1() override
     {
-        //float pending_damage = fetch.get<float>();
+        wire_quantiser& quant = get_wire_quantiser();
+
+        byte_vector vec;
+        vec.push_back<float>(quant.unquantise_damage(quant.quantise_damage(pending_network_damage)));
+        vec.push_back<int32_t>(0);
+
+        return vec;
+    }
 
+    ///0 is damage from a client, 1 is the host's hp
+    virtual void deserialise_network_v1(net_view& fetch) override
+    {
         float found_data = fetch.get<float>();
 
         int32_t type = fetch.get<int32_t>();
@@ -79,7 +124,16 @@ struct damageable_host : virtual damageable_base, virtual networkable_host
 {
     damageable_host(network_state& ns) : networkable_host(ns) {}
 
-    virtual byte_vector serialise_network() override
+    virtual void serialise_fields(delta_fields& out) override
+    {
+        out.vec.push_back<uint8_t>(damage_flags::HOST_HP);
+        out.end_field();
+
+        out.vec.push_back<uint8_t>(get_wire_quantiser().quantise_hp(hp));
+        out.end_field();
+    }
+
+    virtual byte_vector serialise_network_v1() override
     {
         byte_vector ret;
         ret.push_back<float>(hp);
@@ -88,7 +142,7 @@ struct damageable_host : virtual damageable_base, virtual networkable_host
         return ret;
     }
 
-    /*virtual void deserialise_network(byte_fetch& fetch) override
+    /*virtual void deserialise_network(net_view& fetch) override
     {
         ///received from a client
         float pending_damage = fetch.get<float>();
@@ -99,8 +153,8 @@ struct damageable_host : virtual damageable_base, virtual networkable_host
 
 
 ///Ok. On any projectile collision, client or host, we need to spawn the explosion graphic
-///Only host wants to do collision detection
-struct projectile_base : virtual renderable, virtual collideable, virtual base_class, virtual network_serialisable
+///Only host wants to do collision detection, and only host does the explosion's area damage
+struct projectile_base : virtual verlet_body, virtual renderable, virtual collideable, virtual base_class, virtual network_serialisable
 {
     vec2f pos;
     int type = 0;
@@ -122,19 +176,29 @@ struct projectile_base : virtual renderable, virtual collideable, virtual base_c
         team = id;
     }
 
-    void render(sf::RenderWindow& win) override
+    void render(batch_renderer& batch) override
+    {
+        batch.add_circle(pos, rad, sf::Color::White);
+    }
+
+    bool get_render_bounds(vec2f& tl, vec2f& br) override
     {
-        sf::CircleShape shape;
-        shape.setRadius(rad);
+        tl = pos - rad;
+        br = pos + rad;
 
-        shape.setOrigin(rad, rad);
+        return true;
+    }
 
-        shape.setPosition(pos.x(), pos.y());
+    virtual void serialise_fields(delta_fields& out) override
+    {
+        get_wire_quantiser().push_pos(out.vec, pos);
+        out.end_field();
 
-        win.draw(shape);
+        out.vec.push_back<uint8_t>(should_cleanup ? projectile_flags::SHOULD_CLEANUP : 0);
+        out.end_field();
     }
 
-    virtual byte_vector serialise_network() override
+    virtual byte_vector serialise_network_v1() override
     {
         byte_vector vec;
 
@@ -152,87 +216,32 @@ struct projectile_base : virtual renderable, virtual collideable, virtual base_c
     virtual ~projectile_base() {}
 };
 
-struct explosion_projectile_base : virtual projectile_base, virtual networkable_none
+struct projectile : virtual projectile_base, virtual networkable_client
 {
-    std::map<collideable*, bool> hit;
-    float alive_time = 0.f;
-    float alive_time_max = 0.15f;
-
-    explosion_projectile_base() : collideable(-3, collide::RAD), projectile_base(-3)
-    {
-        rad = 10.f;
-
-        collision_dim = {rad * 2.f, rad * 2.f};
-    }
-
-    virtual void tick(float dt_s, state& st) override
-    {
-        alive_time += dt_s;
-
-        if(alive_time > alive_time_max)
-        {
-            should_cleanup = true;
-        }
-
-        set_collision_pos(pos);
-    }
-
-    virtual byte_vector serialise_network() override
-    {
-        return byte_vector();
-    }
+    bool have_pos = false;
 
+    projectile(int team) : projectile_base(team), collideable(team, collide::RAD) {}
 
-    virtual void on_cleanup(state& st) {}
+    projectile() : collideable(-1, collide::RAD) {}
 
-    virtual void process_recv(network_state& st)
+    virtual void deserialise_network(net_view& fetch) override
     {
+        vec2f fpos = get_wire_quantiser().get_pos(fetch);
+        should_cleanup = (fetch.get<uint8_t>() & projectile_flags::SHOULD_CLEANUP) != 0;
 
+        set_network_pos(fpos);
     }
 
-    virtual ~explosion_projectile_base(){}
-};
-
-struct explosion_projectile_client : virtual explosion_projectile_base
-{
-    explosion_projectile_client() : collideable(-3, collide::RAD), explosion_projectile_base() {}
-
-    virtual ~explosion_projectile_client(){}
-};
-
-struct explosion_projectile_host : virtual explosion_projectile_base
-{
-    explosion_projectile_host() : collideable(-3, collide::RAD), explosion_projectile_base() {}
-
-    virtual void on_collide(state& st, collideable* other)
+    virtual void deserialise_network_v1(net_view& fetch) override
     {
-        if(hit[other])
-            return;
-
-        hit[other] = true;
+        vec2f fpos = fetch.get<vec2f>();
+        should_cleanup = fetch.get<int32_t>();
 
-        if(dynamic_cast<damageable_base*>(other) != nullptr)
-        {
-            dynamic_cast<damageable_base*>(other)->damage(0.35);
-        }
+        set_network_pos(fpos);
     }
 
-    virtual ~explosion_projectile_host(){}
-};
-
-struct projectile : virtual projectile_base, virtual networkable_client
-{
-    bool have_pos = false;
-
-    projectile(int team) : projectile_base(team), collideable(team, collide::RAD) {}
-
-    projectile() : collideable(-1, collide::RAD) {}
-
-    virtual void deserialise_network(byte_fetch& fetch) override
+    void set_network_pos(vec2f fpos)
     {
-        vec2f fpos = fetch.get<vec2f>();
-        should_cleanup = fetch.get<int32_t>();
-
         pos = fpos;
 
         if(!have_pos)
@@ -269,25 +278,39 @@ struct host_projectile : virtual projectile_base, virtual networkable_host
         }
     }
 
-    void tick(float dt_s, state& st) override
+    void integrate_begin(float dt_s, state& st, verlet_batch& batch) override
     {
         #ifdef PROJECTILE_GRAVITY
         dir += (vec2f){0, 1} * GRAVITY_STRENGTH * dt_s;
         #endif
 
-        pos = pos + dir * dt_s * speed;
+        ///we fly in a straight line at a known speed, there's no last position to work it out from
+        vec2f vel = dir * dt_s * speed;
+
+        batch_id = batch.add_velocity(pos, vel, {0, 0}, {0, 0}, {1, 1}, 1.f, 0.f);
+    }
+
+    void tick(float dt_s, state& st) override
+    {
+        pos = integrated_pos;
 
         set_collision_pos(pos);
     }
 
-    virtual void deserialise_network(byte_fetch& fetch) override
+    virtual void deserialise_network(net_view& fetch) override
     {
-        vec2f fpos = fetch.get<vec2f>();
-        should_cleanup = fetch.get<int32_t>();
+        vec2f fpos = get_wire_quantiser().get_pos(fetch);
+        should_cleanup = (fetch.get<uint8_t>() & projectile_flags::SHOULD_CLEANUP) != 0;
 
         //pos = fpos;
     }
 
+    virtual void deserialise_network_v1(net_view& fetch) override
+    {
+        vec2f fpos = fetch.get<vec2f>();
+        should_cleanup = fetch.get<int32_t>();
+    }
+
     virtual void on_cleanup(state& st) override;
 
     virtual ~host_projectile() {}
@@ -2,9 +2,17 @@
 #define NETWORKING_HPP_INCLUDED
 
 #include "2d_quacku_servers/master_server/network_messages.hpp"
+#include "2d_quacku_servers/frame_scheduler_shared.hpp"
+#include "2d_quacku_servers/quantise_shared.hpp"
+#include "2d_quacku_servers/wire_v2_shared.hpp"
+#include "2d_quacku_servers/delta_shared.hpp"
 
 #include "systems.hpp"
 
+#include <unordered_map>
+#include <memory>
+#include <string.h>
+
 inline
 udp_sock join_game(const std::string& address, const std::string& port)
 {
@@ -57,6 +65,202 @@ struct network_variable
     }*/
 };
 
+///received datagrams are kept whole in one of these, shared by every message view into them
+///udp_receive_from gives us a fresh vector which is moved in, so a datagram is never copied after it arrives,
+///and it's freed when the last view of it goes
+using datagram_buffer = std::shared_ptr<std::vector<char>>;
+
+///a read cursor over part of a datagram, same interface as byte_fetch for what messages need
+///reading past the end gives you zeroes and sets overran, it never reads outside [offset, offset + length)
+struct net_view
+{
+    datagram_buffer buf;
+
+    uint32_t offset = 0;
+    uint32_t length = 0;
+
+    ///relative to offset
+    uint32_t pos = 0;
+
+    bool overran = false;
+
+    net_view(){}
+
+    net_view(const datagram_buffer& pbuf) : buf(pbuf), offset(0), length(pbuf->size()) {}
+
+    net_view(const datagram_buffer& pbuf, uint32_t poffset, uint32_t plength) : buf(pbuf), offset(poffset), length(plength) {}
+
+    uint32_t remaining() const
+    {
+        return length - pos;
+    }
+
+    bool finished() const
+    {
+        return pos >= length;
+    }
+
+    template<typename T>
+    T get()
+    {
+        T ret = T();
+
+        if(remaining() < sizeof(T))
+        {
+            pos = length;
+            overran = true;
+
+            return ret;
+        }
+
+        memcpy(&ret, buf->data() + offset + pos, sizeof(T));
+
+        pos += sizeof(T);
+
+        return ret;
+    }
+
+    void skip(uint32_t bytes)
+    {
+        if(remaining() < bytes)
+        {
+            pos = length;
+            overran = true;
+
+            return;
+        }
+
+        pos += bytes;
+    }
+
+    ///the next bytes as their own view, this one doesn't move
+    net_view peek(uint32_t bytes) const
+    {
+        return net_view(buf, offset + pos, std::min(bytes, remaining()));
+    }
+};
+
+///receiving side, one per slave entity. Rebuilds the sender's whole state so deserialise_network doesn't know any of this happened
+struct delta_decoder
+{
+    datagram_buffer baseline = std::make_shared<std::vector<char>>();
+
+    delta_stream stream;
+
+    ///reads the whole message either way. true if baseline is now the sender's state
+    ///someone else's event for the owner is never the owner's state
+    bool decode(net_view& fetch)
+    {
+        uint32_t len = fetch.remaining();
+
+        bool ok = delta_apply(fetch.buf->data() + fetch.offset + fetch.pos, len, *baseline, stream);
+
+        fetch.skip(len);
+
+        return ok;
+    }
+};
+
+///received FORWARDING messages waiting for the entity they're for
+///keyed on (player_id, object_id, system_network_id), so an entity finds its messages with one lookup
+///and everything left over after entities have taken theirs is for an entity we don't have yet
+///
+///anything nobody takes within expiry_us is dropped, eg messages for systems that don't network
+struct network_inbox
+{
+    struct message
+    {
+        ///covers just the message's payload
+        net_view fetch;
+
+        ///1 is an older build's whole state in raw floats, see network_serialisable::deserialise_network_v1
+        int version = 2;
+    };
+
+    struct entry
+    {
+        network_variable var;
+
+        ///oldest first
+        std::vector<message> messages;
+
+        int64_t first_received_us = 0;
+    };
+
+    int64_t expiry_us = 1000 * 1000;
+
+    std::unordered_map<uint64_t, entry> entries;
+
+    int num_expired = 0;
+
+    static uint64_t key(int32_t player_id, int32_t object_id, int32_t system_network_id)
+    {
+        return ((uint64_t)(uint32_t)player_id << 32) | ((uint64_t)(uint16_t)object_id << 16) | (uint16_t)system_network_id;
+    }
+
+    void add(const network_variable& var, const net_view& fetch, int version = 2)
+    {
+        entry& e = entries[key(var.player_id, var.object_id, var.system_network_id)];
+
+        if(e.messages.size() == 0)
+        {
+            e.var = var;
+            e.first_received_us = scheduler_now_us();
+        }
+
+        e.messages.push_back({fetch, version});
+    }
+
+    ///calls func(net_view&, int version) on each message for this entity, in the order they arrived, and removes them
+    template<typename T>
+    void take(int32_t player_id, int32_t object_id, int32_t system_network_id, T func)
+    {
+        auto found = entries.find(key(player_id, object_id, system_network_id));
+
+        if(found == entries.end())
+            return;
+
+        for(message& m : found->second.messages)
+        {
+            func(m.fetch, m.version);
+        }
+
+        entries.erase(found);
+    }
+
+    ///whatever's left for this system after every entity's had its turn
+    void unclaimed(int32_t system_network_id, std::vector<network_variable>& out)
+    {
+        for(auto& it : entries)
+        {
+            if(it.second.var.system_network_id == system_network_id)
+                out.push_back(it.second.var);
+        }
+    }
+
+    void expire()
+    {
+        int64_t now = scheduler_now_us();
+
+        for(auto it = entries.begin(); it != entries.end();)
+        {
+            if(now - it->second.first_received_us > expiry_us)
+            {
+                num_expired += it->second.messages.size();
+
+                it = entries.erase(it);
+            }
+            else
+                it++;
+        }
+    }
+
+    void clear()
+    {
+        entries.clear();
+    }
+};
+
 ///so, network state should take other systems
 ///each system has a network id
 ///when receiving an object, we will have its system as part of its id
@@ -75,33 +279,166 @@ struct network_state
         return (my_id != -1) && (sock.valid());
     }
 
+    std::string server_address = "127.0.0.1";
+
     float timeout_max = 5.f;
     float timeout = timeout_max;
 
-    std::vector<std::tuple<network_variable, byte_fetch, bool>> available_data;
+    network_inbox inbox;
+
+    ///running totals, for the profiler
+    uint64_t bytes_in = 0;
+    uint64_t bytes_out = 0;
+    uint64_t datagrams_out = 0;
+
+    ///forward_data packs messages in here back to back, the same as the server's packet_clumper,
+    ///and it goes out as one datagram per max_datagram_size when flush_sends is called
+    std::vector<char> send_buffer;
+    ///forward_data_v1's, which can't go in a v2 datagram
+    std::vector<char> send_buffer_v1;
+
+    ///leaves room for ip and udp headers under a 1280 byte mtu
+    int max_datagram_size = 1200;
+
+    ///see wire_v2_shared.hpp. Entities send the v1 format until the server's agreed v2
+    int protocol_version = 1;
+    bool version_agreed = false;
+
+    ///the server's got players on an older build, so entities send them the v1 format as well as v2
+    bool legacy_peers = false;
+
+    ///the offer's resent every second until we get an answer, after max_version_offers we assume the server's v1 only
+    float version_offer_timeout = 0.f;
+    int version_offers = 0;
+    int max_version_offers = 5;
+
+    ///the server only relays things near here to us often, see send_view_region
+    float view_region_interval_s = 0.1f;
+    int64_t last_view_region_us = -1;
+
+    ///when the oldest packet that hasn't made it into a drawn frame yet arrived, or -1
+    int64_t unrendered_receive_us = -1;
 
     void tick_join_game(float dt_s)
     {
         if(my_id != -1)
+        {
+            tick_offer_version(dt_s);
             return;
+        }
 
         timeout += dt_s;
 
         if(timeout > timeout_max)
         {
-            sock = join_game("127.0.0.1", GAMESERVER_PORT);
+            sock = join_game(server_address, GAMESERVER_PORT);
 
             timeout = 0;
         }
     }
 
+    void tick_offer_version(float dt_s)
+    {
+        if(version_agreed || !sock.valid())
+            return;
+
+        version_offer_timeout += dt_s;
+
+        if(version_offers > 0 && version_offer_timeout < 1.f)
+            return;
+
+        if(version_offers >= max_version_offers)
+        {
+            set_protocol_version(1);
+            return;
+        }
+
+        byte_vector vec;
+        vec.push_back(canary_start);
+        vec.push_back(message::PROTOCOL_VERSION);
+        vec.push_back<int32_t>(WIRE_VERSION);
+        vec.push_back(canary_end);
+
+        udp_send_to(sock, vec.ptr, (const sockaddr*)&store);
+
+        bytes_out += vec.ptr.size();
+        datagrams_out++;
+
+        version_offer_timeout = 0.f;
+        version_offers++;
+    }
+
+    void set_protocol_version(int version)
+    {
+        ///anything queued is framed for the old version
+        flush_sends();
+
+        protocol_version = std::min(std::max(version, 1), WIRE_VERSION);
+        version_agreed = true;
+
+        if(protocol_version < 2)
+            printf("server is an older build that only speaks v1, entities are sent the old way\n");
+    }
+
+    ///whether entities should send the v1 format. Until a version's agreed the server thinks we're v1 too
+    bool sends_v1() const
+    {
+        return protocol_version < 2 || legacy_peers;
+    }
+
     void leave_game()
     {
         sock.close();
 
+        inbox.clear();
+        send_buffer.clear();
+        send_buffer_v1.clear();
+
+        protocol_version = 1;
+        version_agreed = false;
+        legacy_peers = false;
+        last_view_region_us = -1;
+        version_offers = 0;
+        version_offer_timeout = 0.f;
+
         my_id = -1;
     }
 
+    ///no canaries to check, the crc covers everything
+    void recv_v2(const datagram_buffer& buf)
+    {
+        wire_v2_reader reader(buf->data(), buf->size());
+
+        if(!reader.valid)
+        {
+            printf("dropped a bad v2 datagram\n");
+            return;
+        }
+
+        uint8_t type = 0;
+        uint32_t offset = 0;
+        uint32_t len = 0;
+
+        while(reader.next(type, offset, len))
+        {
+            ///nothing else is sent as v2 yet, and anything newer than us just gets skipped
+            if(type != message::FORWARDING)
+                continue;
+
+            if(len < sizeof(network_variable))
+            {
+                printf("forwarding size %u doesn't fit\n", len);
+                continue;
+            }
+
+            net_view message(buf, offset, len);
+
+            network_variable nv = message.get<network_variable>();
+
+            inbox.add(nv, message.peek(message.remaining()));
+        }
+    }
+
     void tick()
     {
         if(!sock.valid())
@@ -115,10 +452,20 @@ struct network_state
 
             any_recv = data.size() > 0;
 
-            byte_fetch fetch;
-            fetch.ptr.swap(data);
+            bytes_in += data.size();
+
+            if(any_recv && unrendered_receive_us == -1)
+                unrendered_receive_us = scheduler_now_us();
 
-            //this_frame_stats.bytes_in += data.size();
+            datagram_buffer buf = std::make_shared<std::vector<char>>(std::move(data));
+
+            if(wire_is_v2(buf->data(), buf->size()))
+            {
+                recv_v2(buf);
+                continue;
+            }
+
+            net_view fetch(buf);
 
             while(!fetch.finished() && any_recv)
             {
@@ -131,18 +478,24 @@ struct network_state
 
                 int32_t type = fetch.get<int32_t>();
 
+                ///an older build's entities, or anyone's while they're still agreeing a version
                 if(type == message::FORWARDING)
                 {
                     uint32_t data_size = fetch.get<uint32_t>();
 
+                    if(data_size < sizeof(network_variable) || data_size > fetch.remaining() || fetch.remaining() - data_size < sizeof(canary_end))
+                    {
+                        printf("forwarding size %u doesn't fit\n", data_size);
+                        break;
+                    }
+
                     network_variable nv = fetch.get<network_variable>();
 
-                    available_data.push_back(std::make_tuple(nv, fetch, false));
+                    uint32_t payload_size = data_size - sizeof(network_variable);
 
-                    for(int i=0; i < (data_size - sizeof(network_variable)) && i < 255; i++)
-                    {
-                        fetch.get<uint8_t>();
-                    }
+                    net_view message = fetch.peek(payload_size);
+
+                    fetch.skip(payload_size);
 
                     auto found_end = fetch.get<decltype(canary_end)>();
 
@@ -150,6 +503,24 @@ struct network_state
                     {
                         printf("forwarding ruh roh\n");
                     }
+                    else
+                    {
+                        inbox.add(nv, message, 1);
+                    }
+                }
+
+                if(type == message::LEGACY_PEERS)
+                {
+                    int32_t num = fetch.get<int32_t>();
+
+                    int32_t found_end = fetch.get<decltype(canary_end)>();
+
+                    if(found_end == canary_end)
+                        legacy_peers = num > 0;
+                    else
+                    {
+                        printf("err in LEGACY_PEERS\n");
+                    }
                 }
 
                 if(type == message::CLIENTJOINACK)
@@ -201,11 +572,49 @@ struct network_state
                 {
                     fetch.get<decltype(canary_end)>();
                 }
+
+                if(type == message::PROTOCOL_VERSION)
+                {
+                    int32_t version = fetch.get<int32_t>();
+
+                    ///v2 and up, the precision everyone on this server uses
+                    wire_quantiser quant = get_wire_quantiser();
+
+                    bool valid = version < 2 || quant.get_settings(fetch);
+
+                    int32_t found_end = fetch.get<decltype(canary_end)>();
+
+                    if(found_end == canary_end && valid)
+                    {
+                        get_wire_quantiser() = quant;
+
+                        set_protocol_version(version);
+                    }
+                    else
+                    {
+                        printf("err in PROTOCOL_VERSION\n");
+                    }
+                }
             }
         }
     }
 
     void forward_data(int player_id, int object_id, int system_network_id, const byte_vector& vec)
+    {
+        ///nobody on the other end could read it
+        if(protocol_version < 2)
+            return;
+
+        network_variable nv(player_id, object_id, system_network_id);
+
+        begin_v2_message(message::FORWARDING, sizeof(nv) + vec.ptr.size());
+
+        send_buffer.insert(send_buffer.end(), (const char*)&nv, (const char*)&nv + sizeof(nv));
+        send_buffer.insert(send_buffer.end(), vec.ptr.begin(), vec.ptr.end());
+    }
+
+    ///the old framing, canaries and all, for older builds. What goes in is up to the entity, see serialise_network_v1
+    void forward_data_v1(int player_id, int object_id, int system_network_id, const byte_vector& vec)
     {
         network_variable nv(player_id, object_id, system_network_id);
 
@@ -219,7 +628,78 @@ struct network_state
         cv.push_vector(vec);
         cv.push_back(canary_end);
 
-        udp_send_to(sock, cv.ptr, (const sockaddr*)&store);
+        if(send_buffer_v1.size() > 0 && send_buffer_v1.size() + cv.ptr.size() > max_datagram_size)
+            flush_sends();
+
+        send_buffer_v1.insert(send_buffer_v1.end(), cv.ptr.begin(), cv.ptr.end());
+    }
+
+    ///makes room in send_buffer for a message with this much payload and writes its type and length, the payload's up to the caller
+    void begin_v2_message(uint8_t type, uint32_t payload_size)
+    {
+        ///type byte and the longest varint a message this size could need
+        uint32_t message_size = 1 + 5 + payload_size;
+
+        if(send_buffer.size() > 0 && send_buffer.size() + message_size > max_datagram_size)
+            flush_sends();
+
+        if(send_buffer.size() == 0)
+            wire_v2_begin(send_buffer);
+
+        send_buffer.push_back((char)type);
+
+        wire_push_varint(send_buffer, payload_size);
+    }
+
+    ///world space rectangle we're looking at. The server relays things outside it (plus a margin) to us less often
+    ///a server that's not said it does v2 wouldn't know what this is, so it's not sent, and we get everything
+    void send_view_region(vec2f tl, vec2f br)
+    {
+        if(protocol_version < 2 || !connected())
+            return;
+
+        int64_t now = scheduler_now_us();
+
+        if(last_view_region_us != -1 && now - last_view_region_us < view_region_interval_s * 1000000)
+            return;
+
+        last_view_region_us = now;
+
+        wire_quantiser& quant = get_wire_quantiser();
+
+        byte_vector vec;
+        quant.push_pos(vec, tl);
+        quant.push_pos(vec, br);
+
+        begin_v2_message(message::VIEW_REGION, vec.ptr.size());
+
+        send_buffer.insert(send_buffer.end(), vec.ptr.begin(), vec.ptr.end());
+    }
+
+    void send_datagram(std::vector<char>& data)
+    {
+        if(data.size() == 0)
+            return;
+
+        if(sock.valid())
+        {
+            udp_send_to(sock, data, (const sockaddr*)&store);
+
+            bytes_out += data.size();
+            datagrams_out++;
+        }
+
+        data.clear();
+    }
+
+    ///sends everything forward_data and forward_data_v1 have queued up, call once a tick after all the updates
+    void flush_sends()
+    {
+        if(send_buffer.size() > 0 && protocol_version >= 2)
+            wire_v2_finish(send_buffer);
+
+        send_datagram(send_buffer);
+        send_datagram(send_buffer_v1);
     }
 
     /*int16_t get_next_object_id()
@@ -227,20 +707,22 @@ struct network_state
         return next_object_id++;
     }*/
 
+    ///anything left in the inbox for this manager's system is for an entity we haven't got, so make it
+    ///and let it have its messages straight away. Call after every entity's had process_recv
     template<typename manager_type, typename real_type>
     void check_create_network_entity(manager_type& generic_manager)
     {
-        for(auto& i : available_data)
-        {
-            network_variable& var = std::get<0>(i);
+        ///entities only take messages while we're connected, so anything left now isn't news
+        if(!connected())
+            return;
 
-            if(var.system_network_id != generic_manager.system_network_id)
-                continue;
+        std::vector<network_variable> unknown;
 
-            if(var.player_id == my_id)
-                continue;
+        inbox.unclaimed(generic_manager.system_network_id, unknown);
 
-            if(generic_manager.owns(var.object_id, var.player_id))
+        for(network_variable& var : unknown)
+        {
+            if(var.player_id == my_id)
                 continue;
 
             ///make new slave entity here!
@@ -251,25 +733,17 @@ struct network_state
 
             real_type* found_entity = dynamic_cast<real_type*>(new_entity);
 
-            //real_type* found_entity = dynamic_cast<real_type*>(generic_manager.make_new<real_type>());
-
             found_entity->object_id = var.object_id;
             found_entity->set_owner(var.player_id);
             found_entity->ownership_class = var.player_id;
+
+            found_entity->process_recv(*this, generic_manager.system_network_id);
         }
     }
 
     void tick_cleanup()
     {
-        for(int i=0; i<available_data.size(); i++)
-        {
-            if(std::get<2>(available_data[i]))
-            {
-                available_data.erase(available_data.begin() + i);
-                i--;
-                continue;
-            }
-        }
+        inbox.expire();
     }
 };
 
@@ -278,10 +752,22 @@ struct network_serialisable : virtual base_class
     int owning_id = -1;
 
     virtual byte_vector serialise_network() {return byte_vector();};
-    virtual void deserialise_network(byte_fetch& fetch) {};
+    ///what a host sends, split up so that only the fields that changed go out. Defaults to all of serialise_network as one field
+    virtual void serialise_fields(delta_fields& out)
+    {
+        out.vec.push_vector(serialise_network());
+        out.end_field();
+    }
+    ///fetch covers just this message
+    virtual void deserialise_network(net_view& fetch) {};
+
+    ///the v1 format, for older builds: the whole state every time, raw floats and int32s, no delta_kind byte
+    ///mustn't change anything, whatever serialise_network does to mark something as sent still happens when it's called
+    virtual byte_vector serialise_network_v1() {return byte_vector();}
+    virtual void deserialise_network_v1(net_view& fetch) {}
 
     //virtual void update(network_state& state) = 0;
-    virtual void process_recv(network_state& state) = 0;
+    virtual void process_recv(network_state& state, int system_network_id) = 0;
 
     virtual void set_owner(int id)
     {
@@ -291,7 +777,7 @@ struct network_serialisable : virtual base_class
 
 struct networkable_none : virtual network_serialisable
 {
-    virtual void process_recv(network_state& state) {}
+    virtual void process_recv(network_state& state, int system_network_id) {}
 };
 
 struct networkable_host : virtual network_serialisable
@@ -302,7 +788,9 @@ struct networkable_host : virtual network_serialisable
         set_owner(ns.my_id);
     }
 
-    ///send serialisable properties across network
+    delta_encoder delta_out;
+
+    ///send serialisable properties across network, as much of them as changed anyway
     virtual void update(network_state& ns, int system_network_id)
     {
         if(!ns.connected())
@@ -310,37 +798,64 @@ struct networkable_host : virtual network_serialisable
 
         set_owner(ns.my_id);
 
-        ns.forward_data(owning_id, object_id, system_network_id, serialise_network());
+        if(ns.sends_v1())
+            ns.forward_data_v1(owning_id, object_id, system_network_id, serialise_network_v1());
+
+        ///forward_data would drop it, and the encoder would think it'd sent a keyframe
+        if(ns.protocol_version < 2)
+            return;
+
+        delta_fields fields;
+        serialise_fields(fields);
+        fields.end_field();
+
+        byte_vector encoded;
+
+        if(!delta_out.encode(fields, encoded))
+            return;
+
+        ns.forward_data(owning_id, object_id, system_network_id, encoded);
     }
 
-    ///don't need system id here, only for creating new networkable clients
-    virtual void process_recv(network_state& ns)
+    virtual void process_recv(network_state& ns, int system_network_id)
     {
         if(!ns.connected())
             return;
 
         set_owner(ns.my_id);
 
-        for(auto& i : ns.available_data)
+        ns.inbox.take(owning_id, object_id, system_network_id, [&](net_view& fetch, int version)
         {
-            network_variable& var = std::get<0>(i);
-
-            if(var.player_id == owning_id && var.object_id == object_id)
+            if(version < 2)
             {
-                deserialise_network(std::get<1>(i));
+                deserialise_network_v1(fetch);
 
-                byte_fetch& fetch = std::get<1>(i);
+                if(fetch.overran)
+                    printf("error host process recv v1\n");
 
-                int canary = fetch.get<decltype(canary_end)>();
+                return;
+            }
 
-                if(canary != canary_end)
-                {
-                    printf("error host process recv\n");
-                }
+            uint8_t kind = fetch.get<uint8_t>();
 
-                std::get<2>(i) = true;
+            ///someone missed some of our state, so the next update's a keyframe
+            if(kind == delta_kind::RESYNC)
+                delta_out.resync_requested = true;
+
+            ///other than that the only thing anyone else sends about our entities is events
+            if(kind != delta_kind::EVENT)
+            {
+                fetch.skip(fetch.remaining());
+                return;
             }
-        }
+
+            deserialise_network(fetch);
+
+            if(fetch.overran)
+            {
+                printf("error host process recv\n");
+            }
+        });
     }
 };
 
@@ -359,36 +874,66 @@ struct networkable_client : virtual network_serialisable
         if(!should_update)
             return;
 
-        ns.forward_data(owning_id, object_id, system_network_id, serialise_network());
+        ///before serialise_network, which counts as having sent it whichever of the two goes out
+        byte_vector v1 = serialise_network_v1();
+
+        byte_vector vec;
+        vec.push_back<uint8_t>(delta_kind::EVENT);
+        vec.push_vector(serialise_network());
+
+        if(ns.sends_v1())
+            ns.forward_data_v1(owning_id, object_id, system_network_id, v1);
+
+        if(ns.protocol_version >= 2)
+            ns.forward_data(owning_id, object_id, system_network_id, vec);
 
         should_update = false;
     }
 
-    virtual void process_recv(network_state& ns)
+    ///what we get is the owner's networkable_host::update
+    delta_decoder delta_in;
+
+    virtual void process_recv(network_state& ns, int system_network_id)
     {
         if(!ns.connected())
             return;
 
-        for(auto& i : ns.available_data)
+        ns.inbox.take(owning_id, object_id, system_network_id, [&](net_view& fetch, int version)
         {
-            network_variable& var = std::get<0>(i);
+            ///an older build's whole state, no deltas
+            if(version < 2)
+            {
+                deserialise_network_v1(fetch);
+
+                if(fetch.overran)
+                    printf("error client process recv v1\n");
+
+                return;
+            }
 
-            if(var.player_id == owning_id && var.object_id == object_id)
+            if(delta_in.decode(fetch))
             {
-                deserialise_network(std::get<1>(i));
+                net_view state(delta_in.baseline);
 
-                byte_fetch& fetch = std::get<1>(i);
+                deserialise_network(state);
+            }
 
-                int canary = fetch.get<decltype(canary_end)>();
+            ///we've lost track of the owner's state, ask them for all of it
+            if(delta_in.stream.resync_due)
+            {
+                byte_vector vec;
+                delta_push_resync(vec);
 
-                if(canary != canary_end)
-                {
-                    printf("error host process recv");
-                }
+                ns.forward_data(owning_id, object_id, system_network_id, vec);
 
-                std::get<2>(i) = true;
+                delta_in.stream.resync_due = false;
             }
-        }
+
+            if(fetch.overran)
+            {
+                printf("error client process recv\n");
+            }
+        });
     }
 };
 
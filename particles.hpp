@@ -0,0 +1,147 @@
+#ifndef PARTICLES_HPP_INCLUDED
+#define PARTICLES_HPP_INCLUDED
+
+#include <vector>
+#include <stdint.h>
+#include <math.h>
+
+///purely visual effects, nothing in here touches the simulation or goes over the network
+///
+///particles are plain data in parallel arrays. Live ones are always the first num_alive of each,
+///dead ones get swapped with the last live one, so ticking and drawing is one straight pass and
+///nothing is ever allocated after construction. If the pool's full new particles are dropped
+///
+///has its own rng so effects don't disturb rand(), which replays depend on
+struct particle_system
+{
+    int max_particles = 4096;
+    int num_alive = 0;
+
+    std::vector<vec2f> pos;
+    std::vector<vec2f> vel;
+    std::vector<float> age;
+    std::vector<float> lifetime;
+    std::vector<float> start_rad;
+    std::vector<float> end_rad;
+    std::vector<sf::Color> col;
+
+    uint32_t rng_seed = 0x9e3779b9;
+    uint32_t rng_state = rng_seed;
+
+    batch_renderer batch;
+
+    particle_system()
+    {
+        pos.resize(max_particles);
+        vel.resize(max_particles);
+        age.resize(max_particles);
+        lifetime.resize(max_particles);
+        start_rad.resize(max_particles);
+        end_rad.resize(max_particles);
+        col.resize(max_particles);
+    }
+
+    ///0 -> 1
+    float random()
+    {
+        rng_state ^= rng_state << 13;
+        rng_state ^= rng_state >> 17;
+        rng_state ^= rng_state << 5;
+
+        return (rng_state & 0xFFFFFF) / (float)0xFFFFFF;
+    }
+
+    void spawn(vec2f p, vec2f v, float life, float rad_from, float rad_to, sf::Color c)
+    {
+        if(num_alive >= max_particles)
+            return;
+
+        int i = num_alive++;
+
+        pos[i] = p;
+        vel[i] = v;
+        age[i] = 0.f;
+        lifetime[i] = life;
+        start_rad[i] = rad_from;
+        end_rad[i] = rad_to;
+        col[i] = c;
+    }
+
+    void kill(int i)
+    {
+        int last = --num_alive;
+
+        pos[i] = pos[last];
+        vel[i] = vel[last];
+        age[i] = age[last];
+        lifetime[i] = lifetime[last];
+        start_rad[i] = start_rad[last];
+        end_rad[i] = end_rad[last];
+        col[i] = col[last];
+    }
+
+    ///the flash the old explosion projectile drew, plus a few sparks
+    void explosion(vec2f p, float rad)
+    {
+        spawn(p, {0, 0}, 0.15f, rad, rad, sf::Color::White);
+
+        int num_sparks = 8;
+
+        for(int i=0; i<num_sparks; i++)
+        {
+            float angle = random() * 2 * M_PI;
+            float speed = rad * (4.f + random() * 8.f);
+
+            vec2f dir = {cosf(angle), sinf(angle)};
+
+            spawn(p, dir * speed, 0.2f + random() * 0.2f, 2.f, 0.f, sf::Color(255, 200, 100));
+        }
+    }
+
+    void tick(float dt_s)
+    {
+        for(int i=0; i<num_alive; i++)
+        {
+            age[i] += dt_s;
+
+            if(age[i] >= lifetime[i])
+            {
+                kill(i);
+                i--;
+                continue;
+            }
+
+            pos[i] = pos[i] + vel[i] * dt_s;
+        }
+    }
+
+    ///all live particles go in as one layer
+    void render(render_snapshot& snap, const cull_rect& cull)
+    {
+        for(int i=0; i<num_alive; i++)
+        {
+            float frac = age[i] / lifetime[i];
+
+            float rad = start_rad[i] + (end_rad[i] - start_rad[i]) * frac;
+
+            if(rad <= 0.f || !cull.overlaps(pos[i] - rad, pos[i] + rad))
+                continue;
+
+            ///sparks don't need a smooth circle
+            int points = rad < 4.f ? 8 : 30;
+
+            batch.add_circle(pos[i], rad, col[i], points);
+        }
+
+        batch.flush(snap);
+    }
+
+    ///back to how it started, so a replay's particles come out the same as the recording's
+    void clear()
+    {
+        num_alive = 0;
+        rng_state = rng_seed;
+    }
+};
+
+#endif // PARTICLES_HPP_INCLUDED
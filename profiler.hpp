@@ -0,0 +1,150 @@
+#ifndef PROFILER_HPP_INCLUDED
+#define PROFILER_HPP_INCLUDED
+
+#include <stdint.h>
+#include "2d_quacku_servers/frame_scheduler_shared.hpp"
+
+///rolling per stage timings for the main loop. A stage is timed with
+///
+///    int64_t start = profiler.begin();
+///    ...
+///    profiler.end(frame_profiler::COLLISIONS, start);
+///
+///which is two clock reads, so it's fine to leave on. A stage can be timed several times in one frame,
+///eg network reads between ticks, and it all adds up into that frame's sample
+struct frame_profiler
+{
+    enum stage
+    {
+        INPUT,
+        CHARACTER_TICK,
+        PROJECTILE_TICK,
+        COLLISIONS,
+        NETWORK_TICK,
+        NETWORK_CLEANUP,
+        NETWORK_CREATE,
+        RENDER,
+        IMGUI,
+        COUNT,
+    };
+
+    static constexpr int history_size = 128;
+
+    int64_t accum_us[COUNT] = {0};
+
+    float history_ms[COUNT][history_size] = {{0}};
+    float frame_history_ms[history_size] = {0};
+
+    ///where the next sample goes
+    int history_pos = 0;
+    int num_samples = 0;
+
+    int64_t last_frame_us = -1;
+
+    ///bytes per second, worked out once a second
+    float bytes_in_per_s = 0;
+    float bytes_out_per_s = 0;
+    float datagrams_out_per_s = 0;
+
+    uint64_t last_bytes_in = 0;
+    uint64_t last_bytes_out = 0;
+    uint64_t last_datagrams_out = 0;
+    int64_t last_bandwidth_us = -1;
+
+    static const char* stage_name(int s)
+    {
+        static const char* names[COUNT] =
+        {
+            "Input",
+            "Character tick",
+            "Projectile tick",
+            "Collisions",
+            "Network tick",
+            "Network cleanup",
+            "Network create",
+            "Render",
+            "ImGui",
+        };
+
+        return names[s];
+    }
+
+    int64_t begin()
+    {
+        return scheduler_now_us();
+    }
+
+    void end(stage s, int64_t start_us)
+    {
+        accum_us[s] += scheduler_now_us() - start_us;
+    }
+
+    ///byte and datagram counts are running totals
+    void end_frame(uint64_t bytes_in, uint64_t bytes_out, uint64_t datagrams_out)
+    {
+        int64_t now = scheduler_now_us();
+
+        for(int i=0; i<COUNT; i++)
+        {
+            history_ms[i][history_pos] = accum_us[i] / 1000.f;
+            accum_us[i] = 0;
+        }
+
+        frame_history_ms[history_pos] = last_frame_us == -1 ? 0.f : (now - last_frame_us) / 1000.f;
+        last_frame_us = now;
+
+        history_pos = (history_pos + 1) % history_size;
+        num_samples = std::min(num_samples + 1, history_size);
+
+        if(last_bandwidth_us == -1)
+        {
+            last_bandwidth_us = now;
+            last_bytes_in = bytes_in;
+            last_bytes_out = bytes_out;
+            last_datagrams_out = datagrams_out;
+        }
+
+        float elapsed_s = (now - last_bandwidth_us) / 1000000.f;
+
+        if(elapsed_s >= 1.f)
+        {
+            bytes_in_per_s = (bytes_in - last_bytes_in) / elapsed_s;
+            bytes_out_per_s = (bytes_out - last_bytes_out) / elapsed_s;
+            datagrams_out_per_s = (datagrams_out - last_datagrams_out) / elapsed_s;
+
+            last_bytes_in = bytes_in;
+            last_bytes_out = bytes_out;
+            last_datagrams_out = datagrams_out;
+            last_bandwidth_us = now;
+        }
+    }
+
+    float average_ms(int s) const
+    {
+        if(num_samples == 0)
+            return 0.f;
+
+        float total = 0;
+
+        for(int i=0; i<num_samples; i++)
+        {
+            total += history_ms[s][i];
+        }
+
+        return total / num_samples;
+    }
+
+    float max_ms(int s) const
+    {
+        float ret = 0;
+
+        for(int i=0; i<num_samples; i++)
+        {
+            ret = std::max(ret, history_ms[s][i]);
+        }
+
+        return ret;
+    }
+};
+
+#endif // PROFILER_HPP_INCLUDED
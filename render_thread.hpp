@@ -0,0 +1,188 @@
+#ifndef RENDER_THREAD_HPP_INCLUDED
+#define RENDER_THREAD_HPP_INCLUDED
+
+#include <SFML/Graphics.hpp>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+
+///draws the world on its own thread, so a slow draw doesn't hold up physics and networking
+///
+///the simulation fills in back() every tick and publish()es it. The render thread always draws the newest
+///published snapshot and drops any it didn't get to. Snapshots only hold shared immutable vertex arrays
+///and a view, so neither side ever touches anything the other is using
+///
+///the window's GL context and imgui stay on the main thread, so the world is drawn into one of two
+///sf::RenderTextures (which get their own context on this thread) and present() just puts the last
+///finished one on the window under imgui. That's one draw on the main thread whatever the map looks like
+struct render_thread
+{
+    ///main thread fills this in
+    render_snapshot building;
+    ///newest published, waiting for the render thread
+    render_snapshot pending;
+    ///render thread draws this
+    render_snapshot drawing;
+
+    bool has_pending = false;
+
+    sf::RenderTexture targets[2];
+    sf::Vector2u target_size[2];
+
+    ///which target present() should show, -1 until something's been drawn
+    ///the render thread only ever draws into the other one
+    int ready = -1;
+
+    ///receive_us of what's been drawn since present() last asked
+    int64_t ready_receive_us = -1;
+
+    ///stats for the last frame drawn, get_render_stats itself belongs to the render thread
+    render_stats last_stats;
+
+    std::thread worker;
+    std::mutex lock;
+    std::condition_variable wake;
+    bool quit = false;
+
+    void start()
+    {
+        quit = false;
+        worker = std::thread(&render_thread::worker_func, this);
+    }
+
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            quit = true;
+        }
+
+        wake.notify_all();
+
+        if(worker.joinable())
+            worker.join();
+    }
+
+    ~render_thread()
+    {
+        stop();
+    }
+
+    ///cleared, ready for this tick's render calls
+    render_snapshot& back()
+    {
+        building.clear();
+
+        return building;
+    }
+
+    void publish()
+    {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+
+            ///the render thread never got to the last one, don't lose track of its packets
+            if(has_pending && pending.receive_us != -1)
+                building.receive_us = building.receive_us == -1 ? pending.receive_us : std::min(building.receive_us, pending.receive_us);
+
+            std::swap(building, pending);
+            has_pending = true;
+        }
+
+        wake.notify_one();
+    }
+
+    render_stats get_stats()
+    {
+        std::lock_guard<std::mutex> guard(lock);
+
+        return last_stats;
+    }
+
+    ///main thread, call between win.clear() and ImGui::Render()
+    ///returns the receive_us of anything going on screen for the first time, or -1
+    int64_t present(sf::RenderWindow& win)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+
+        if(ready == -1)
+            return -1;
+
+        ///the snapshot's view is already baked into the texture
+        sf::View old_view = win.getView();
+        win.setView(win.getDefaultView());
+
+        sf::Sprite sprite(targets[ready].getTexture());
+        win.draw(sprite);
+
+        ///get_mouse_position_world goes through the window's view
+        win.setView(old_view);
+
+        int64_t receive_us = ready_receive_us;
+        ready_receive_us = -1;
+
+        return receive_us;
+    }
+
+    void worker_func()
+    {
+        while(1)
+        {
+            int target = 0;
+
+            {
+                std::unique_lock<std::mutex> guard(lock);
+
+                wake.wait(guard, [&]{return quit || has_pending;});
+
+                if(quit)
+                    break;
+
+                std::swap(drawing, pending);
+                has_pending = false;
+
+                target = ready == 0 ? 1 : 0;
+            }
+
+            sf::Vector2u dim = drawing.target_size;
+
+            if(dim.x == 0 || dim.y == 0)
+                continue;
+
+            if(target_size[target] != dim)
+            {
+                if(!targets[target].create(dim.x, dim.y))
+                {
+                    printf("Could not create a %ix%i render target\n", dim.x, dim.y);
+                    continue;
+                }
+
+                target_size[target] = dim;
+            }
+
+            get_render_stats().reset();
+
+            targets[target].clear();
+            drawing.draw(targets[target]);
+            targets[target].display();
+
+            std::lock_guard<std::mutex> guard(lock);
+
+            ready = target;
+
+            if(drawing.receive_us != -1)
+                ready_receive_us = ready_receive_us == -1 ? drawing.receive_us : std::min(ready_receive_us, drawing.receive_us);
+
+            last_stats = get_render_stats();
+        }
+
+        ///the contexts were made on this thread
+        for(sf::RenderTexture& target : targets)
+        {
+            target.setActive(false);
+        }
+    }
+};
+
+#endif // RENDER_THREAD_HPP_INCLUDED
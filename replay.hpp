@@ -0,0 +1,497 @@
+#ifndef REPLAY_HPP_INCLUDED
+#define REPLAY_HPP_INCLUDED
+
+#include <string>
+#include <fstream>
+#include <cstdlib>
+
+///recording and replaying player input, so that we can run exactly the same simulation over and over
+///for benchmarking and checking physics changes don't alter behaviour
+///replays are offline, so recordings are too. Recording won't start while connected, and stops (without saving) if we connect
+///
+///a recording starts from a clean slate: no projectiles or other characters, and the player reset with
+///reset_simulation_state, so all a replay needs to know is the seed, the map and where the player was
+///
+///a streamed map is too big to put in the recording, so it stores the mapfile's name instead and both
+///ends stream it synchronously (see chunk_streamer::make_synchronous)
+
+namespace input_flag
+{
+    enum input_flag : uint8_t
+    {
+        JUMP = 1,
+        FRICTION_OFF = 2,
+        JETPACK = 4,
+        FIRE = 8,
+        GRAPPLE = 16,
+        UNHOOK = 32,
+        CHARACTER_TICK = 64, ///whether characters ticked this frame
+    };
+}
+
+///everything the player did in one tick
+struct tick_input
+{
+    float dt_s = 0.f;
+    vec2f move_dir = {0,0};
+    vec2f mouse_world = {0,0};
+    uint8_t flags = 0;
+
+    bool has(input_flag::input_flag f) const
+    {
+        return (flags & f) != 0;
+    }
+
+    void set(input_flag::input_flag f)
+    {
+        flags |= f;
+    }
+
+    ///dt, flags, move dir as two int8s, and the mouse only if we used it
+    void serialise(byte_vector& vec) const
+    {
+        vec.push_back<float>(dt_s);
+        vec.push_back<uint8_t>(flags);
+        vec.push_back<int8_t>(move_dir.x());
+        vec.push_back<int8_t>(move_dir.y());
+
+        if(has(input_flag::FIRE) || has(input_flag::GRAPPLE))
+            vec.push_back<vec2f>(mouse_world);
+    }
+
+    ///flags is the second thing, and decides the rest
+    static uint32_t serialised_size(uint8_t pflags)
+    {
+        uint32_t size = sizeof(float) + sizeof(uint8_t) + sizeof(int8_t) * 2;
+
+        if((pflags & (input_flag::FIRE | input_flag::GRAPPLE)) != 0)
+            size += sizeof(vec2f);
+
+        return size;
+    }
+
+    void deserialise(byte_fetch& fetch)
+    {
+        dt_s = fetch.get<float>();
+        flags = fetch.get<uint8_t>();
+        move_dir.x() = fetch.get<int8_t>();
+        move_dir.y() = fetch.get<int8_t>();
+
+        if(has(input_flag::FIRE) || has(input_flag::GRAPPLE))
+            mouse_world = fetch.get<vec2f>();
+    }
+};
+
+///before characters tick
+inline
+void apply_movement_input(const tick_input& in, player_character* player)
+{
+    player->set_movement(in.move_dir * 1000.f);
+}
+
+///after characters and projectiles tick
+inline
+void apply_action_input(const tick_input& in, state& st, player_character* player)
+{
+    if(in.has(input_flag::JUMP))
+        player->jump();
+
+    player->has_friction = !in.has(input_flag::FRICTION_OFF);
+
+    if(in.has(input_flag::JETPACK))
+        player->should_jetpack = true;
+
+    if(in.has(input_flag::FIRE))
+        player->fire(in.mouse_world, st);
+
+    if(in.has(input_flag::GRAPPLE))
+        player->fire_grapple(in.mouse_world, st);
+
+    if(in.has(input_flag::UNHOOK))
+        player->unhook();
+}
+
+///fnv1a over everything that moves
+inline
+uint64_t hash_simulation_state(state& st)
+{
+    uint64_t hash = 14695981039346656037ull;
+
+    auto add = [&](const void* ptr, int len)
+    {
+        const uint8_t* bytes = (const uint8_t*)ptr;
+
+        for(int i=0; i<len; i++)
+        {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+    };
+
+    for(character_base* c : st.character_manage.objs)
+    {
+        add(&c->pos, sizeof(c->pos));
+        add(&c->hp, sizeof(c->hp));
+    }
+
+    for(projectile_base* p : st.projectile_manage.objs)
+    {
+        add(&p->pos, sizeof(p->pos));
+    }
+
+    particle_system& particles = st.particles;
+
+    add(&particles.num_alive, sizeof(particles.num_alive));
+
+    if(particles.num_alive > 0)
+        add(&particles.pos[0], sizeof(vec2f) * particles.num_alive);
+
+    ///which bits of a streamed map were loaded
+    uint32_t num_segments = st.physics_barrier_manage.segments.size();
+
+    add(&num_segments, sizeof(num_segments));
+
+    return hash;
+}
+
+#define REPLAY_MAGIC 0x50455251
+#define REPLAY_VERSION 3
+
+namespace replay_map
+{
+    enum type : int32_t
+    {
+        EMBEDDED,
+        STREAMED,
+    };
+}
+
+///header
+///int32 magic
+///int32 version
+///uint32 seed
+///int32 replay_map type
+///int32 map length, map (EMBEDDED: same as the mapfile, STREAMED: the mapfile's name)
+///vec2f player pos, vec2f player last pos
+///int32 number of ticks, ticks
+///uint64 final state hash
+struct input_recorder
+{
+    bool started = false;
+
+    ///one recording per run, so the file doesn't get overwritten when we go back into player mode
+    bool finished = false;
+
+    bool warned_connected = false;
+
+    uint32_t seed = 0;
+    byte_vector header;
+    byte_vector ticks;
+    int32_t num_ticks = 0;
+
+    ///removes everything the replay won't have
+    static void reset_world(state& st, player_character* player)
+    {
+        std::vector<projectile_base*> projectiles = st.projectile_manage.objs;
+
+        for(projectile_base* p : projectiles)
+        {
+            st.projectile_manage.destroy(p);
+        }
+
+        st.projectile_manage.pending_area_damage.clear();
+
+        std::vector<character_base*> characters = st.character_manage.objs;
+
+        for(character_base* c : characters)
+        {
+            if(c != player)
+                st.character_manage.destroy(c);
+        }
+
+        st.particles.clear();
+
+        player->reset_simulation_state();
+    }
+
+    void begin(uint32_t pseed, state& st, player_character* player, chunk_streamer& streamer, const std::string& map_file)
+    {
+        if(started || finished)
+            return;
+
+        if(st.net_state.connected())
+        {
+            if(!warned_connected)
+                printf("Not recording while connected to a server\n");
+
+            warned_connected = true;
+            return;
+        }
+
+        reset_world(st, player);
+
+        ///streaming focuses on the camera too
+        st.cam.set_pos(player->pos);
+
+        seed = pseed;
+
+        ///everything random from here on out comes from the seed, eg projectile colours
+        srand(seed);
+
+        byte_vector map;
+        int32_t map_type = replay_map::EMBEDDED;
+
+        if(streamer.active)
+        {
+            streamer.make_synchronous(st);
+
+            map.ptr.assign(map_file.begin(), map_file.end());
+            map_type = replay_map::STREAMED;
+        }
+        else
+        {
+            map = serialise_map(st.physics_barrier_manage, st.game_world_manage);
+        }
+
+        header = byte_vector();
+        header.push_back<int32_t>(REPLAY_MAGIC);
+        header.push_back<int32_t>(REPLAY_VERSION);
+        header.push_back<uint32_t>(seed);
+        header.push_back<int32_t>(map_type);
+        header.push_back<int32_t>(map.ptr.size());
+        header.push_vector(map);
+        header.push_back<vec2f>(player->pos);
+        header.push_back<vec2f>(player->last_pos);
+
+        ticks = byte_vector();
+        num_ticks = 0;
+
+        started = true;
+    }
+
+    void record(const tick_input& in)
+    {
+        if(!started)
+            return;
+
+        in.serialise(ticks);
+        num_ticks++;
+    }
+
+    void finish(const std::string& file, state& st)
+    {
+        if(!started)
+            return;
+
+        byte_vector out;
+        out.push_vector(header);
+        out.push_back<int32_t>(num_ticks);
+        out.push_vector(ticks);
+        out.push_back<uint64_t>(hash_simulation_state(st));
+
+        std::ofstream fout;
+        fout.open(file, std::ios::binary | std::ios::out);
+
+        if(out.ptr.size() > 0)
+            fout.write((char*)&out.ptr[0], out.ptr.size());
+
+        printf("Recorded %i ticks to %s\n", num_ticks, file.c_str());
+
+        started = false;
+        finished = true;
+    }
+
+    ///something happened that the replay can't reproduce
+    void abandon(const char* why)
+    {
+        if(!started)
+            return;
+
+        printf("Recording abandoned, %s\n", why);
+
+        started = false;
+        finished = true;
+    }
+};
+
+///runs a recording headless as fast as it'll go
+///returns 0 if the final state matches the recording, 1 if it doesn't
+int run_replay(const std::string& file)
+{
+    byte_fetch fetch = get_file(file);
+
+    if(fetch.ptr.size() < sizeof(int32_t) * 2)
+    {
+        printf("Could not read replay %s\n", file.c_str());
+        return 1;
+    }
+
+    ///everything's checked against this before it's read, so a broken replay can't run off the end or ask for a huge buffer
+    uint32_t remaining = fetch.ptr.size();
+
+    auto take = [&](uint32_t bytes)
+    {
+        if(bytes > remaining)
+            return false;
+
+        remaining -= bytes;
+        return true;
+    };
+
+    auto bad_replay = [&]()
+    {
+        printf("Bad replay %s\n", file.c_str());
+        return 1;
+    };
+
+    if(!take(sizeof(int32_t) * 5))
+        return bad_replay();
+
+    int32_t magic = fetch.get<int32_t>();
+    int32_t version = fetch.get<int32_t>();
+
+    if(magic != REPLAY_MAGIC || version != REPLAY_VERSION)
+    {
+        printf("Bad replay header in %s\n", file.c_str());
+        return 1;
+    }
+
+    uint32_t seed = fetch.get<uint32_t>();
+    int32_t map_type = fetch.get<int32_t>();
+    int32_t map_len = fetch.get<int32_t>();
+
+    if(map_len < 0 || !take(map_len) || (map_type != replay_map::EMBEDDED && map_type != replay_map::STREAMED))
+        return bad_replay();
+
+    std::vector<char> map_data = fetch.get_buf(map_len);
+
+    if(!take(sizeof(vec2f) * 2 + sizeof(int32_t)))
+        return bad_replay();
+
+    vec2f start_pos = fetch.get<vec2f>();
+    vec2f start_last_pos = fetch.get<vec2f>();
+
+    int32_t num_ticks = fetch.get<int32_t>();
+
+    ///every tick is at least this big, which bounds the resize
+    if(num_ticks < 0 || (uint64_t)num_ticks * tick_input::serialised_size(0) > remaining)
+        return bad_replay();
+
+    std::vector<tick_input> inputs;
+    inputs.resize(num_ticks);
+
+    for(tick_input& in : inputs)
+    {
+        ///the flags come after dt
+        if(remaining < sizeof(float) + sizeof(uint8_t))
+            return bad_replay();
+
+        uint8_t flags = fetch.ptr[fetch.ptr.size() - remaining + sizeof(float)];
+
+        if(!take(tick_input::serialised_size(flags)))
+            return bad_replay();
+
+        in.deserialise(fetch);
+    }
+
+    if(!take(sizeof(uint64_t)))
+        return bad_replay();
+
+    uint64_t expected_hash = fetch.get<uint64_t>();
+
+    sf::RenderWindow dummy_win;
+
+    renderable_manager renderable_manage;
+    character_manager character_manage;
+    physics_barrier_manager physics_barrier_manage;
+    game_world_manager game_world_manage;
+    projectile_manager projectile_manage;
+    particle_system particles;
+    camera cam(dummy_win);
+    network_state net_state;
+
+    state st(character_manage, physics_barrier_manage, game_world_manage, renderable_manage, projectile_manage, particles, cam, net_state);
+
+    st.character_manage.system_network_id = 0;
+    st.physics_barrier_manage.system_network_id = 1;
+    st.game_world_manage.system_network_id = 2;
+    st.renderable_manage.system_network_id = 3;
+    st.projectile_manage.system_network_id = 4;
+
+    chunk_streamer streamer;
+
+    if(map_type == replay_map::STREAMED)
+    {
+        std::string map_file(map_data.begin(), map_data.end());
+
+        if(!streamer.open(map_file, physics_barrier_manage, game_world_manage, renderable_manage))
+        {
+            printf("Couldn't stream %s for replay %s\n", map_file.c_str(), file.c_str());
+            return 1;
+        }
+    }
+    else if(!deserialise_map(map_data.data(), map_data.size(), physics_barrier_manage, game_world_manage, renderable_manage))
+    {
+        printf("Bad map in replay %s\n", file.c_str());
+        return 1;
+    }
+
+    player_character* player = dynamic_cast<player_character*>(character_manage.make_new<player_character>(-2, net_state));
+
+    player->pos = start_pos;
+    player->last_pos = start_last_pos;
+    player->reset_simulation_state();
+
+    cam.set_pos(player->pos);
+
+    streamer.make_synchronous(st);
+
+    srand(seed);
+
+    sf::Clock clk;
+
+    ///the same order as main, minus everything that doesn't change the simulation
+    for(const tick_input& in : inputs)
+    {
+        st.dt_s = in.dt_s;
+
+        apply_movement_input(in, player);
+
+        if(in.has(input_flag::CHARACTER_TICK))
+            character_manage.tick(in.dt_s, st);
+
+        projectile_manage.tick(in.dt_s, st);
+
+        apply_action_input(in, st, player);
+
+        cam.set_pos(player->pos);
+
+        streamer.tick(st);
+
+        projectile_manage.check_collisions(st, character_manage);
+        projectile_manage.apply_area_damage(st, character_manage);
+        physics_barrier_manage.check_collisions(st, projectile_manage);
+
+        particles.tick(in.dt_s);
+
+        projectile_manage.cleanup(st);
+    }
+
+    float time_ms = clk.getElapsedTime().asMicroseconds() / 1000.f;
+
+    uint64_t found_hash = hash_simulation_state(st);
+
+    printf("Replayed %i ticks in %f ms (%f us per tick)\n", num_ticks, time_ms, num_ticks > 0 ? time_ms * 1000.f / num_ticks : 0.f);
+
+    if(found_hash != expected_hash)
+    {
+        printf("Final state MISMATCH, expected %llx got %llx\n", (unsigned long long)expected_hash, (unsigned long long)found_hash);
+        return 1;
+    }
+
+    printf("Final state matches\n");
+
+    return 0;
+}
+
+#endif // REPLAY_HPP_INCLUDED
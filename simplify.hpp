@@ -0,0 +1,67 @@
+#ifndef SIMPLIFY_HPP_INCLUDED
+#define SIMPLIFY_HPP_INCLUDED
+
+#include <vector>
+#include <vec/vec.hpp>
+
+///shared by the map compiler and the static geometry lod tiers
+
+///all the points of a run, in order
+inline
+void map_simplify_run(const std::vector<vec2f>& points, float max_deviation, std::vector<vec2f>& out)
+{
+    if(points.size() < 2)
+        return;
+
+    std::vector<uint8_t> keep;
+    keep.resize(points.size());
+
+    keep.front() = 1;
+    keep.back() = 1;
+
+    ///douglas peucker, with an explicit stack so long runs don't blow it
+    std::vector<std::pair<int, int>> stack;
+    stack.push_back({0, (int)points.size() - 1});
+
+    while(stack.size() > 0)
+    {
+        std::pair<int, int> range = stack.back();
+        stack.pop_back();
+
+        vec2f p1 = points[range.first];
+        vec2f p2 = points[range.second];
+
+        float max_dist = 0;
+        int max_id = -1;
+
+        ///loops start and end at the same point
+        bool degenerate = (p2 - p1).length() < 0.0001f;
+
+        for(int i=range.first + 1; i<range.second; i++)
+        {
+            float dist = degenerate ? (points[i] - p1).length() : point2line_shortest(p1, (p2 - p1).norm(), points[i]).length();
+
+            if(dist > max_dist)
+            {
+                max_dist = dist;
+                max_id = i;
+            }
+        }
+
+        if(max_id == -1 || max_dist <= max_deviation)
+            continue;
+
+        keep[max_id] = 1;
+
+        stack.push_back({range.first, max_id});
+        stack.push_back({max_id, range.second});
+    }
+
+    for(int i=0; i<points.size(); i++)
+    {
+        if(keep[i])
+            out.push_back(points[i]);
+    }
+}
+
+#endif // SIMPLIFY_HPP_INCLUDED
@@ -0,0 +1,210 @@
+#ifndef SPATIAL_INDEX_HPP_INCLUDED
+#define SPATIAL_INDEX_HPP_INCLUDED
+
+#include <vector>
+#include <stdint.h>
+#include <math.h>
+#include <algorithm>
+#include <vec/vec.hpp>
+
+///uniform grid of segment indices
+///stored flat (cell_start/cell_items, like a sparse matrix) so it can be written to and read from a file as is
+///segments added after the grid was built go into pending and get scanned linearly until the next rebuild
+struct segment_grid
+{
+    vec2f origin = {0,0};
+    float cell_size = 64.f;
+    int32_t width = 0;
+    int32_t height = 0;
+
+    ///width * height + 1 entries, items for cell i are cell_items[cell_start[i]] -> cell_items[cell_start[i+1]]
+    std::vector<uint32_t> cell_start;
+    std::vector<uint32_t> cell_items;
+
+    ///indices added since the last build
+    std::vector<uint32_t> pending;
+
+    ///rebuild once this many segments are pending
+    int max_pending = 256;
+
+    ///so each segment only gets reported once per query
+    std::vector<uint32_t> stamps;
+    uint32_t cur_stamp = 0;
+
+    int32_t num_segments = 0;
+
+    void clear()
+    {
+        width = 0;
+        height = 0;
+        cell_start.clear();
+        cell_items.clear();
+        pending.clear();
+        stamps.clear();
+        num_segments = 0;
+    }
+
+    vec2i to_cell(vec2f pos) const
+    {
+        vec2f rel = (pos - origin) / cell_size;
+
+        int x = std::min(std::max((int)floor(rel.x()), 0), std::max(width - 1, 0));
+        int y = std::min(std::max((int)floor(rel.y()), 0), std::max(height - 1, 0));
+
+        return {x, y};
+    }
+
+    ///p1s and p2s are segment endpoints, indexed by segment id
+    void build(const std::vector<vec2f>& p1s, const std::vector<vec2f>& p2s)
+    {
+        clear();
+
+        num_segments = p1s.size();
+
+        stamps.resize(num_segments);
+
+        if(num_segments == 0)
+            return;
+
+        vec2f tl = p1s[0];
+        vec2f br = p1s[0];
+
+        for(int i=0; i<num_segments; i++)
+        {
+            for(vec2f p : {p1s[i], p2s[i]})
+            {
+                tl.x() = std::min(tl.x(), p.x());
+                tl.y() = std::min(tl.y(), p.y());
+                br.x() = std::max(br.x(), p.x());
+                br.y() = std::max(br.y(), p.y());
+            }
+        }
+
+        vec2f dim = br - tl;
+
+        ///aim for a handful of segments per cell
+        float area = std::max(dim.x() * dim.y(), 1.f);
+
+        cell_size = std::max(sqrtf(area / std::max(num_segments / 4.f, 1.f)), 16.f);
+
+        origin = tl;
+        width = (int)(dim.x() / cell_size) + 1;
+        height = (int)(dim.y() / cell_size) + 1;
+
+        int num_cells = width * height;
+
+        ///count, prefix sum, then fill
+        std::vector<uint32_t> counts;
+        counts.resize(num_cells);
+
+        for(int i=0; i<num_segments; i++)
+        {
+            vec2i c1, c2;
+            get_cell_bounds(p1s[i], p2s[i], c1, c2);
+
+            for(int y=c1.y(); y<=c2.y(); y++)
+                for(int x=c1.x(); x<=c2.x(); x++)
+                    counts[y * width + x]++;
+        }
+
+        cell_start.resize(num_cells + 1);
+        cell_start[0] = 0;
+
+        for(int i=0; i<num_cells; i++)
+        {
+            cell_start[i + 1] = cell_start[i] + counts[i];
+        }
+
+        cell_items.resize(cell_start[num_cells]);
+
+        for(int i=0; i<num_cells; i++)
+        {
+            counts[i] = cell_start[i];
+        }
+
+        for(int i=0; i<num_segments; i++)
+        {
+            vec2i c1, c2;
+            get_cell_bounds(p1s[i], p2s[i], c1, c2);
+
+            for(int y=c1.y(); y<=c2.y(); y++)
+                for(int x=c1.x(); x<=c2.x(); x++)
+                    cell_items[counts[y * width + x]++] = i;
+        }
+    }
+
+    void get_cell_bounds(vec2f p1, vec2f p2, vec2i& c1, vec2i& c2) const
+    {
+        vec2f tl = {std::min(p1.x(), p2.x()), std::min(p1.y(), p2.y())};
+        vec2f br = {std::max(p1.x(), p2.x()), std::max(p1.y(), p2.y())};
+
+        c1 = to_cell(tl);
+        c2 = to_cell(br);
+    }
+
+    ///returns true if the caller should rebuild
+    bool add(uint32_t id)
+    {
+        pending.push_back(id);
+
+        num_segments = std::max(num_segments, (int32_t)id + 1);
+        stamps.resize(num_segments);
+
+        return (int)pending.size() > max_pending;
+    }
+
+    ///calls func(segment_id) once for every segment that might overlap the box tl -> br
+    template<typename T>
+    void query(vec2f tl, vec2f br, T func)
+    {
+        cur_stamp++;
+
+        if(cur_stamp == 0)
+        {
+            std::fill(stamps.begin(), stamps.end(), 0);
+            cur_stamp = 1;
+        }
+
+        for(uint32_t id : pending)
+        {
+            if(stamps[id] == cur_stamp)
+                continue;
+
+            stamps[id] = cur_stamp;
+
+            func(id);
+        }
+
+        if(width == 0 || height == 0)
+            return;
+
+        ///entirely outside the grid
+        if(br.x() < origin.x() || br.y() < origin.y() || tl.x() > origin.x() + width * cell_size || tl.y() > origin.y() + height * cell_size)
+            return;
+
+        vec2i c1 = to_cell(tl);
+        vec2i c2 = to_cell(br);
+
+        for(int y=c1.y(); y<=c2.y(); y++)
+        {
+            for(int x=c1.x(); x<=c2.x(); x++)
+            {
+                int cell = y * width + x;
+
+                for(uint32_t i=cell_start[cell]; i<cell_start[cell + 1]; i++)
+                {
+                    uint32_t id = cell_items[i];
+
+                    if(stamps[id] == cur_stamp)
+                        continue;
+
+                    stamps[id] = cur_stamp;
+
+                    func(id);
+                }
+            }
+        }
+    }
+};
+
+#endif // SPATIAL_INDEX_HPP_INCLUDED
@@ -6,6 +6,7 @@ struct physics_barrier_manager;
 struct game_world_manager;
 struct renderable_manager;
 struct projectile_manager;
+struct particle_system;
 struct network_state;
 struct camera;
 
@@ -16,6 +17,7 @@ struct state
     game_world_manager& game_world_manage;
     renderable_manager& renderable_manage;
     projectile_manager& projectile_manage;
+    particle_system& particles;
     camera& cam;
     network_state& net_state;
     float dt_s = 0.1f;
@@ -25,6 +27,7 @@ struct state
           game_world_manager& pgame_world_manage,
           renderable_manager& prenderable_manage,
           projectile_manager& pprojectile_manage,
+          particle_system& pparticles,
           camera& pcam,
           network_state& pnet_state)
           :
@@ -35,6 +38,7 @@ struct state
              game_world_manage(pgame_world_manage),
              renderable_manage(prenderable_manage),
              projectile_manage(pprojectile_manage),
+             particles(pparticles),
              cam(pcam),
              net_state(pnet_state)
      {}
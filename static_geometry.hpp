@@ -0,0 +1,280 @@
+#ifndef STATIC_GEOMETRY_HPP_INCLUDED
+#define STATIC_GEOMETRY_HPP_INCLUDED
+
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <cfloat>
+#include "simplify.hpp"
+
+///the map's barriers baked into one vertex array per chunk
+///barriers belong to the chunk their midpoint is in, and a chunk is only rebuilt when something in it changes
+///drawing the map is then one draw per visible chunk, however many segments there are
+///
+///zoomed out, chunks are drawn from lod tiers instead. Tier n is for when a pixel is 2^(n+1) world units or more:
+///runs are simplified to within half a pixel, anything that ends up inside one pixel is dropped, and
+///what's left is drawn as 1 pixel lines. Tiers are built the first time they're needed and thrown away
+///with the full detail geometry whenever the chunk changes
+struct static_geometry_cache
+{
+    struct chunk
+    {
+        std::vector<int32_t> ids;
+
+        ///rebaking makes a new array rather than touching this one, a snapshot on the render thread might still be drawing it
+        std::shared_ptr<sf::VertexArray> verts;
+
+        ///[tier], nullptr if it's not been built. Same rule as verts
+        std::vector<std::shared_ptr<sf::VertexArray>> lods;
+
+        ///of the geometry, which can hang outside the chunk
+        vec2f tl;
+        vec2f br;
+
+        bool dirty = true;
+    };
+
+    float chunk_size = 512.f;
+
+    ///past this we just keep using the coarsest tier
+    int max_lod = 8;
+
+    std::unordered_map<uint64_t, chunk> chunks;
+
+    ///membership needs working out again from scratch, eg after a load
+    bool all_dirty = true;
+
+    uint64_t chunk_key(const physics_barrier& bar)
+    {
+        vec2f mid = (bar.p1 + bar.p2) / 2.f;
+
+        int32_t x = (int32_t)floor(mid.x() / chunk_size);
+        int32_t y = (int32_t)floor(mid.y() / chunk_size);
+
+        return ((uint64_t)(uint32_t)x << 32) | (uint32_t)y;
+    }
+
+    void invalidate_all()
+    {
+        all_dirty = true;
+    }
+
+    ///a segment was appended
+    void add(int32_t id, const physics_barrier& bar)
+    {
+        if(all_dirty)
+            return;
+
+        chunk& c = chunks[chunk_key(bar)];
+
+        c.ids.push_back(id);
+        c.dirty = true;
+    }
+
+    ///segments first -> first + count were erased and everything after them moved down
+    ///chunks that only had their ids shift keep what they've baked, it's the same geometry
+    void remove_range(int32_t first, int32_t count)
+    {
+        if(all_dirty || count == 0)
+            return;
+
+        for(auto it = chunks.begin(); it != chunks.end();)
+        {
+            chunk& c = it->second;
+
+            int kept = 0;
+
+            for(int32_t id : c.ids)
+            {
+                if(id >= first && id < first + count)
+                    continue;
+
+                c.ids[kept++] = id >= first + count ? id - count : id;
+            }
+
+            if(kept != c.ids.size())
+            {
+                c.ids.resize(kept);
+                c.dirty = true;
+            }
+
+            if(c.ids.size() == 0)
+                it = chunks.erase(it);
+            else
+                it++;
+        }
+    }
+
+    void rebuild_membership(const std::vector<physics_barrier>& segments)
+    {
+        chunks.clear();
+
+        for(int i=0; i<segments.size(); i++)
+        {
+            chunks[chunk_key(segments[i])].ids.push_back(i);
+        }
+
+        all_dirty = false;
+    }
+
+    void bake(chunk& c, std::vector<physics_barrier>& segments)
+    {
+        c.verts = std::make_shared<sf::VertexArray>(sf::Triangles);
+        c.lods.clear();
+
+        c.tl = {FLT_MAX, FLT_MAX};
+        c.br = {-FLT_MAX, -FLT_MAX};
+
+        for(int32_t id : c.ids)
+        {
+            physics_barrier& bar = segments[id];
+
+            bar.render(*c.verts);
+        }
+
+        for(int i=0; i<c.verts->getVertexCount(); i++)
+        {
+            sf::Vector2f pos = (*c.verts)[i].position;
+
+            c.tl = {std::min(c.tl.x(), pos.x), std::min(c.tl.y(), pos.y)};
+            c.br = {std::max(c.br.x(), pos.x), std::max(c.br.y(), pos.y)};
+        }
+
+        c.dirty = false;
+    }
+
+    ///barriers are 5 units thick, so until a pixel's 4 units they still show up fine as they are
+    int lod_for_zoom(float zoom)
+    {
+        if(zoom < 4.f)
+            return 0;
+
+        int lod = (int)floor(log2(zoom)) - 1;
+
+        return std::min(std::max(lod, 1), max_lod);
+    }
+
+    float lod_pixel_size(int lod)
+    {
+        return powf(2.f, lod + 1);
+    }
+
+    void bake_lod(chunk& c, std::vector<physics_barrier>& segments, int lod)
+    {
+        float pixel = lod_pixel_size(lod);
+
+        std::shared_ptr<sf::VertexArray> verts = std::make_shared<sf::VertexArray>(sf::Lines);
+
+        std::unordered_set<int32_t> members(c.ids.begin(), c.ids.end());
+        std::unordered_set<int32_t> visited;
+
+        ///segments as pairs of pixels, so several segments landing on the same pixels only get drawn once
+        std::unordered_set<uint64_t> drawn;
+
+        ///16 bits each is plenty, everything in a chunk is close together
+        auto pixel_key = [&](vec2f pos)
+        {
+            int32_t x = (int32_t)floor(pos.x() / pixel);
+            int32_t y = (int32_t)floor(pos.y() / pixel);
+
+            return ((uint64_t)(uint16_t)x << 16) | (uint16_t)y;
+        };
+
+        std::vector<vec2f> run;
+        std::vector<vec2f> simplified;
+
+        ///follows next through this chunk, same as the map compiler does for the whole map
+        auto emit_run = [&](int32_t first)
+        {
+            run.clear();
+            run.push_back(segments[first].p1);
+
+            int32_t cur = first;
+
+            while(cur != -1 && members.count(cur) && !visited.count(cur))
+            {
+                visited.insert(cur);
+
+                run.push_back(segments[cur].p2);
+
+                cur = segments[cur].next;
+            }
+
+            simplified.clear();
+
+            map_simplify_run(run, pixel / 2.f, simplified);
+
+            for(int i=0; i + 1<simplified.size(); i++)
+            {
+                uint64_t k1 = pixel_key(simplified[i]);
+                uint64_t k2 = pixel_key(simplified[i+1]);
+
+                if(k1 == k2)
+                    continue;
+
+                uint64_t key = (std::min(k1, k2) << 32) | std::max(k1, k2);
+
+                if(drawn.count(key))
+                    continue;
+
+                drawn.insert(key);
+
+                verts->append(sf::Vertex({simplified[i].x(), simplified[i].y()}, sf::Color::White));
+                verts->append(sf::Vertex({simplified[i+1].x(), simplified[i+1].y()}, sf::Color::White));
+            }
+        };
+
+        ///start of every run in this chunk first, then whatever's left is a loop
+        for(int32_t id : c.ids)
+        {
+            int32_t prev = segments[id].prev;
+
+            if(prev == -1 || !members.count(prev))
+                emit_run(id);
+        }
+
+        for(int32_t id : c.ids)
+        {
+            if(!visited.count(id))
+                emit_run(id);
+        }
+
+        if(c.lods.size() <= lod)
+            c.lods.resize(lod + 1);
+
+        c.lods[lod] = verts;
+    }
+
+    void render(render_snapshot& snap, std::vector<physics_barrier>& segments, const cull_rect& cull)
+    {
+        int lod = lod_for_zoom(cull.zoom);
+
+        if(all_dirty)
+            rebuild_membership(segments);
+
+        for(auto& it : chunks)
+        {
+            chunk& c = it.second;
+
+            if(c.dirty)
+                bake(c, segments);
+
+            if(!cull.overlaps(c.tl, c.br))
+                continue;
+
+            if(lod == 0)
+            {
+                snap.add(c.verts);
+                continue;
+            }
+
+            if(c.lods.size() <= lod || c.lods[lod] == nullptr)
+                bake_lod(c, segments, lod);
+
+            snap.add(c.lods[lod]);
+        }
+    }
+};
+
+#endif // STATIC_GEOMETRY_HPP_INCLUDED
@@ -4,6 +4,9 @@
 #include <SFML/Graphics.hpp>
 #include <vec/vec.hpp>
 #include <imgui/imgui.h>
+#include "integrator.hpp"
+#include "texture_cache.hpp"
+#include "batch_renderer.hpp"
 
 #define GRAVITY_STRENGTH 1600.f
 #define FORCE_MULTIPLIER 1.f
@@ -19,33 +22,33 @@ struct base_class
     virtual void on_cleanup(state& st) {}
 };
 
+///everything currently draws the same white square tinted by col, so they all share one texture
+inline
+const texture_handle& get_default_renderable_texture()
+{
+    static texture_handle tex = get_texture_cache().acquire("blank_20");
+
+    return tex;
+}
+
 struct renderable
 {
-    sf::Image img;
-    sf::Texture tex;
+    texture_handle tex;
     vec3f col = {1, 1, 1};
 
     bool should_render = true;
 
-    renderable()
+    renderable() : tex(get_default_renderable_texture())
     {
-        img.create(20, 20, sf::Color(255, 255, 255));
-        tex.loadFromImage(img);
-
         generate_colour();
     }
 
-    virtual void render(sf::RenderWindow& win, vec2f pos)
+    virtual void render(batch_renderer& batch, vec2f pos)
     {
         if(!should_render)
             return;
 
-        sf::Sprite spr(tex);
-        spr.setOrigin(tex.getSize().x/2, tex.getSize().y/2);
-        spr.setPosition({pos.x(), pos.y()});
-        spr.setColor(sf::Color(255 * col.x(), 255 * col.y(),255 * col.z()));
-
-        win.draw(spr);
+        batch.add_sprite(tex.get(), pos, sf::Color(255 * col.x(), 255 * col.y(),255 * col.z()));
     }
 
     void generate_colour()
@@ -55,7 +58,10 @@ struct renderable
         col = randf<3, float>() * ffrac + (1.f - ffrac);
     }
 
-    virtual void render(sf::RenderWindow& win) = 0;
+    virtual void render(batch_renderer& batch) = 0;
+
+    ///world space box everything render draws fits in, for culling. Return false if you don't know
+    virtual bool get_render_bounds(vec2f& tl, vec2f& br) {return false;}
 
     virtual ~renderable()
     {
@@ -174,6 +180,18 @@ struct moveable : virtual base_class
     float side_time_max = 0.100f;
 };
 
+///anything that moves through the batch integrator
+struct verlet_body : virtual base_class
+{
+    ///index into the batch for this tick, -1 if we didn't add ourselves
+    int batch_id = -1;
+
+    ///written back by the manager once the batch is integrated
+    vec2f integrated_pos;
+
+    virtual void integrate_begin(float dt_s, state& st, verlet_batch& batch) {}
+};
+
 struct jetpackable : virtual base_class
 {
     float flight_time_max = 1.f;
@@ -298,56 +316,12 @@ struct grappling_hookable : virtual renderable
         source = pos;
     }
 
-    vec2f apply_constraint(vec2f p1, vec2f anchor, float dt) const
-    {
-        float len = (anchor - p1).length();
-
-        if(len <= cur_hook_dist)
-            return p1;
-
-        float extra = len - cur_hook_dist;
-
-        vec2f to_anchor = (anchor - p1).norm();
-
-        float move_dist = dt * extra;
-
-        float stiffness = 1000000000000.f;
-
-        move_dist *= stiffness;
-
-        move_dist = clamp(move_dist, 0.f, extra);
-
-        vec2f constrained = p1 + to_anchor * move_dist;
-
-        return constrained;
-    }
-
-    vec2f apply_constraint(vec2f p1, float dt)
-    {
-        return apply_constraint(p1, destination, dt);
-    }
-
-    virtual void render(sf::RenderWindow& win)
+    virtual void render(batch_renderer& batch)
     {
         if(!hooking)
             return;
 
-        sf::RectangleShape shape;
-
-        shape.setSize({(destination - source).length(), 2.f});
-        shape.setOrigin(0, 1);
-
-        shape.setPosition(source.x(), source.y());
-        shape.setRotation(r2d((destination - source).angle()));
-
-        win.draw(shape);
-
-        sf::CircleShape circle;
-        circle.setRadius(10.f);
-
-        circle.setPosition(destination.x(), destination.y());
-        circle.setPosition(source.x(), source.y());
-        //win.draw(circle);
+        batch.add_rect(source, {(destination - source).length(), 2.f}, {0, 1}, (destination - source).angle(), sf::Color::White);
     }
 };
 
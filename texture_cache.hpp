@@ -0,0 +1,119 @@
+#ifndef TEXTURE_CACHE_HPP_INCLUDED
+#define TEXTURE_CACHE_HPP_INCLUDED
+
+#include <SFML/Graphics.hpp>
+#include <unordered_map>
+#include <memory>
+#include <string>
+
+///textures shared by name, so that creating an object never has to create or upload one
+///entries are reference counted, but only freed when purge_unused is called (on map change) so that
+///the last projectile dying doesn't throw away the texture the next one wants
+///
+///characters get one per team (team_info::get_texture_cache_name), everything else shares blank_20
+
+struct texture_cache_entry
+{
+    sf::Texture tex;
+    int refs = 0;
+};
+
+struct texture_handle
+{
+    texture_cache_entry* entry = nullptr;
+
+    texture_handle() {}
+
+    explicit texture_handle(texture_cache_entry* e) : entry(e)
+    {
+        if(entry)
+            entry->refs++;
+    }
+
+    texture_handle(const texture_handle& other) : texture_handle(other.entry) {}
+
+    texture_handle& operator=(const texture_handle& other)
+    {
+        if(other.entry)
+            other.entry->refs++;
+
+        release();
+
+        entry = other.entry;
+
+        return *this;
+    }
+
+    void release()
+    {
+        if(entry)
+            entry->refs--;
+
+        entry = nullptr;
+    }
+
+    const sf::Texture& get() const
+    {
+        return entry->tex;
+    }
+
+    sf::Vector2u getSize() const
+    {
+        return entry ? entry->tex.getSize() : sf::Vector2u(0, 0);
+    }
+
+    ~texture_handle()
+    {
+        release();
+    }
+};
+
+struct texture_cache
+{
+    std::unordered_map<std::string, std::unique_ptr<texture_cache_entry>> textures;
+
+    ///so we can see if anything is still uploading on the hot path
+    int num_uploads = 0;
+
+    ///a solid white texture of dim if name isn't in the cache yet
+    texture_handle acquire(const std::string& name, int width = 20, int height = 20)
+    {
+        auto found = textures.find(name);
+
+        if(found != textures.end())
+            return texture_handle(found->second.get());
+
+        sf::Image img;
+        img.create(width, height, sf::Color(255, 255, 255));
+
+        texture_cache_entry* entry = new texture_cache_entry;
+        entry->tex.loadFromImage(img);
+
+        num_uploads++;
+
+        textures[name] = std::unique_ptr<texture_cache_entry>(entry);
+
+        return texture_handle(entry);
+    }
+
+    void purge_unused()
+    {
+        for(auto it = textures.begin(); it != textures.end();)
+        {
+            if(it->second->refs <= 0)
+                it = textures.erase(it);
+            else
+                it++;
+        }
+    }
+};
+
+inline
+texture_cache& get_texture_cache()
+{
+    static texture_cache cache;
+
+    return cache;
+}
+
+#endif // TEXTURE_CACHE_HPP_INCLUDED